@@ -0,0 +1,93 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <common.h>
+
+/* NOTE: Alias tables (Vose's method), for --sizes and --targets.
+
+   Each of the n columns holds 1/n of the draws: Its own entry's share (scaled
+   by n) and the rest of an entry having more than its share. A column is
+   picked at random, then a second random word takes its entry or its alias.
+   The columns are kept in the entries themselves, so a draw loads one or two
+   of them. */
+
+int buildAliasTable(alias_t *columns, uint32_t n, size_t stride, double *weights)
+{
+  uint32_t *small, *large;
+  uint32_t num_small, num_large, i, s, l;
+  alias_t *c;
+  double total, x;
+
+  if ((small = malloc(2 * n * sizeof(uint32_t))) == NULL)
+  {
+    ERROR("Error allocating alias table");
+    return FALSE;
+  }
+  large = small + n;
+
+  for (i = 0, total = 0; i < n; i++)
+    total += weights[i];
+
+  for (i = num_small = num_large = 0; i < n; i++)
+  {
+    weights[i] *= n / total;
+    if (weights[i] < 1.0)
+      small[num_small++] = i;
+    else
+      large[num_large++] = i;
+  }
+
+  while (num_small && num_large)
+  {
+    s = small[--num_small];
+    l = large[num_large - 1];
+
+    c = (void *)columns + s * stride;
+    x = weights[s] * 4294967296.0;
+    c->threshold = x >= 1.0 ? (uint32_t)(x - 1.0) : 0;
+    c->alias = l;
+
+    weights[l] -= 1.0 - weights[s];
+    if (weights[l] < 1.0)
+    {
+      num_large--;
+      small[num_small++] = l;
+    }
+  }
+
+  /* What's left is full (or is, but for rounding errors). Full columns never
+     take their alias. */
+  while (num_large)
+  {
+    l = large[--num_large];
+    c = (void *)columns + l * stride;
+    c->threshold = 0xffffffffU;
+    c->alias = l;
+  }
+  while (num_small)
+  {
+    s = small[--num_small];
+    c = (void *)columns + s * stride;
+    c->threshold = 0xffffffffU;
+    c->alias = s;
+  }
+
+  free(small);
+  return TRUE;
+}
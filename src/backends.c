@@ -0,0 +1,37 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <common.h>
+
+/* NOTE: Output backends table. Works the same way as the modules table (see modules.c).
+
+  To add a backend, implement the four functions (open, send, flush, close) in
+  src/backends/, declare them in backends.h, add a BACKEND_ENTRY and change the Makefile.
+  The first entry is the default one. */
+BEGIN_BACKENDS_TABLE
+            /* ( name,   description,                                 prefix ) */
+  BACKEND_ENTRY("raw",   "Raw IP socket (IPPROTO_RAW)",               raw)
+  BACKEND_ENTRY("ring",  "Memory mapped packet socket TX ring",       ring)
+  BACKEND_ENTRY("uring", "Raw IP socket, asynchronous io_uring sends", uring)
+  BUFFERED_BACKEND_ENTRY("xdp", "AF_XDP socket (packets built on UMEM)", xdp)
+  FILE_BACKEND_ENTRY("pcap", "pcap file (--output)", pcap)
+  FILE_BACKEND_ENTRY("pcapng", "pcapng file (--output)", pcapng)
+  LOCAL_BACKEND_ENTRY("null", "Discards the packets (benchmarks)", null)
+  UDP_BACKEND_ENTRY("gso", "UDP socket, segmentation offload (UDP_SEGMENT)", gso)
+END_BACKENDS_TABLE
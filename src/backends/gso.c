@@ -0,0 +1,190 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <common.h>
+
+/* NOTE: UDP generic segmentation offload backend (gso).
+
+   For UDP tests that don't need custom IP headers: The packets built by udp()
+   aren't sent, only their payload, on a regular UDP socket. The kernel builds
+   the IP and UDP headers (source address and port come from the socket).
+
+   Payloads to the same destination (address and port) are queued one after
+   the other and sent with a single sendmsg(), with UDP_SEGMENT set to their
+   size, so the kernel (or the NIC) splits them into up to GSO_MAX_SEGMENTS
+   datagrams. Anything else (another destination, payload size or a full
+   queue) sends the queue first, so a fixed --dest port and a single target
+   make the biggest sends. Payloads must fit on the MTU. */
+
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+#define GSO_MAX_SEGMENTS 64                     /* kernel's UDP_MAX_SEGMENTS */
+#define GSO_MAX_BYTES    (65535 - sizeof(struct iphdr) - sizeof(struct udphdr))
+
+static __thread socket_t fd = -1;
+
+/* Payloads waiting for sendmsg(). */
+static __thread uint8_t *queue = NULL;
+static __thread size_t queue_len, segment_size;
+static __thread unsigned queue_segments;
+static __thread struct sockaddr_in queue_dest;
+
+int gso_open(const struct config_options * const __restrict__ co)
+{
+  int n;
+
+  if ((fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) == -1)
+  {
+    perror("error opening UDP socket");
+    return FALSE;
+  }
+
+  /* NOTE: Not fatal. The default buffer only makes more sends wait. */
+  n = 1024 * 1024;
+  setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &n, sizeof(n));
+
+  n = 1;
+  if (setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &n, sizeof(n)) == -1)
+  {
+    perror("error setting socket broadcast");
+    goto error;
+  }
+
+  /* Tests if the kernel supports UDP GSO. Segment sizes are set per send. */
+  n = 0;
+  if (setsockopt(fd, SOL_UDP, UDP_SEGMENT, &n, sizeof(n)) == -1)
+  {
+    perror("error setting UDP segmentation (UDP_SEGMENT)");
+    goto error;
+  }
+
+  if ((queue = malloc(GSO_MAX_BYTES)) == NULL)
+  {
+    ERROR("Error allocating GSO queue");
+    goto error;
+  }
+
+  queue_len = queue_segments = 0;
+  return TRUE;
+
+error:
+  close(fd);
+  fd = -1;
+  return FALSE;
+}
+
+void gso_close(void)
+{
+  if (fd != -1)
+    close(fd);
+  fd = -1;
+
+  free(queue);
+  queue = NULL;
+}
+
+int gso_send(const void * const buffer, size_t size, const struct config_options * const __restrict__ co)
+{
+  const struct iphdr *ip = buffer;
+  const struct udphdr *udp;
+  size_t length;
+
+  assert(buffer != NULL);
+  assert(co != NULL);
+
+  /* NOTE: checkConfigOptions() allows UDP, not encapsulated, only. */
+  udp = buffer + ip->ihl * 4;
+  length = ntohs(udp->len) - sizeof(struct udphdr);
+
+  if (queue_segments && (udp->dest != queue_dest.sin_port || ip->daddr != queue_dest.sin_addr.s_addr ||
+                         length != segment_size || queue_len + length > GSO_MAX_BYTES))
+    if (!gso_flush())
+      return FALSE;
+
+  if (queue_segments == 0)
+  {
+    queue_dest.sin_family = AF_INET;
+    queue_dest.sin_port = udp->dest;
+    queue_dest.sin_addr.s_addr = ip->daddr;
+    segment_size = length;
+  }
+
+  memcpy(queue + queue_len, udp + 1, length);
+  queue_len += length;
+
+  /* NOTE: Empty datagrams can't be segmented. */
+  if (++queue_segments == GSO_MAX_SEGMENTS || length == 0)
+    return gso_flush();
+
+  return TRUE;
+}
+
+/* Sends the queue as a single GSO datagram. */
+int gso_flush(void)
+{
+  char control[CMSG_SPACE(sizeof(uint16_t))] = {};
+  struct msghdr msg = {};
+  struct cmsghdr *cmsg;
+  struct iovec iov;
+  int num_tries;
+
+  if (queue_segments == 0)
+    return TRUE;
+
+  iov.iov_base = queue;
+  iov.iov_len = queue_len;
+
+  msg.msg_name = &queue_dest;
+  msg.msg_namelen = sizeof(queue_dest);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+
+  if (queue_segments > 1)
+  {
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_UDP;
+    cmsg->cmsg_type = UDP_SEGMENT;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    *(uint16_t *)CMSG_DATA(cmsg) = segment_size;
+  }
+
+  for (num_tries = MAX_SENDTO_TRIES; num_tries--;)
+  {
+    if (sendmsg(fd, &msg, MSG_NOSIGNAL) != -1)
+    {
+      queue_len = queue_segments = 0;
+      return TRUE;
+    }
+
+    if (!retrySend(&num_tries))
+      break;
+  }
+
+  queue_len = queue_segments = 0;
+  ERROR("Error sending GSO datagram.");
+  return FALSE;
+}
@@ -0,0 +1,176 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <common.h>
+#include <sys/ioctl.h>
+#include <net/route.h>
+#include <net/if_arp.h>
+
+static int getRoute(in_addr_t, char *, in_addr_t *);
+static int getNeighbour(in_addr_t, const char *, uint8_t *);
+
+/* Fills 'li' with the output interface and the MAC addresses used on Ethernet frames.
+   The interface comes from --interface or from the routing table. The destination
+   MAC address comes from --dst-mac or from the ARP table (target or gateway). */
+int getLinkInfo(const struct config_options * const __restrict__ co, struct link_info *li)
+{
+  static const uint8_t zero_mac[ETH_ALEN];
+  struct ifreq ifr = {};
+  char route_iface[IFNAMSIZ];
+  in_addr_t nexthop;
+  int routed;
+  socket_t s;
+
+  assert(co != NULL);
+  assert(li != NULL);
+
+  memset(li, 0, sizeof(struct link_info));
+
+  /* Next hop is the target itself, unless the routing table says otherwise. */
+  nexthop = co->ip.daddr;
+  routed = getRoute(co->ip.daddr, route_iface, &nexthop);
+
+  if (*co->iface)
+  {
+    snprintf(li->name, IFNAMSIZ, "%s", co->iface);
+
+    /* The gateway of a route through another interface is useless here. */
+    if (routed && strcmp(route_iface, li->name))
+      nexthop = co->ip.daddr;
+  }
+  else if (routed)
+    strcpy(li->name, route_iface);
+  else
+  {
+    ERROR("Cannot find a route to the target. Try --interface");
+    return FALSE;
+  }
+
+  if ((s = socket(AF_INET, SOCK_DGRAM, 0)) == -1)
+  {
+    perror("error opening socket");
+    return FALSE;
+  }
+
+  snprintf(ifr.ifr_name, IFNAMSIZ, "%s", li->name);
+
+  if (ioctl(s, SIOCGIFINDEX, &ifr) == -1)
+  {
+    perror(li->name);
+    close(s);
+    return FALSE;
+  }
+  li->ifindex = ifr.ifr_ifindex;
+
+  if (ioctl(s, SIOCGIFMTU, &ifr) == -1)
+  {
+    perror(li->name);
+    close(s);
+    return FALSE;
+  }
+  li->mtu = ifr.ifr_mtu;
+
+  if (ioctl(s, SIOCGIFHWADDR, &ifr) == -1)
+  {
+    perror(li->name);
+    close(s);
+    return FALSE;
+  }
+  memcpy(li->src_mac, ifr.ifr_hwaddr.sa_data, ETH_ALEN);
+
+  close(s);
+
+  /* NOTE: All frames are sent to the same next hop, even when a CIDR is given. */
+  if (memcmp(co->dst_mac, zero_mac, ETH_ALEN))
+    memcpy(li->dst_mac, co->dst_mac, ETH_ALEN);
+  else if (!getNeighbour(nexthop, li->name, li->dst_mac))
+  {
+    fprintf(stderr,
+            "%s: next hop MAC address not found on ARP table. Using broadcast (try --dst-mac).\n",
+            PACKAGE);
+    memset(li->dst_mac, 0xff, ETH_ALEN);
+  }
+
+  return TRUE;
+}
+
+/* Longest prefix match on /proc/net/route. 
+   'nexthop' is changed only if the route has a gateway. */
+static int getRoute(in_addr_t daddr, char *iface, in_addr_t *nexthop)
+{
+  char line[256], name[IFNAMSIZ];
+  unsigned dest, gw, flags, mask;
+  int found, bits, best_bits;
+  FILE *f;
+
+  if ((f = fopen("/proc/net/route", "r")) == NULL)
+    return FALSE;
+
+  found = FALSE;
+  best_bits = -1;
+
+  /* NOTE: Addresses on /proc/net/route are in network order, as stored in memory. */
+  while (fgets(line, sizeof(line), f))
+  {
+    if (sscanf(line, "%15s %x %x %x %*d %*d %*d %x", name, &dest, &gw, &flags, &mask) != 5)
+      continue;   /* header line. */
+
+    if (!(flags & RTF_UP) || (daddr & mask) != dest)
+      continue;
+
+    bits = __builtin_popcount(mask);
+    if (bits > best_bits)
+    {
+      best_bits = bits;
+      found = TRUE;
+
+      strcpy(iface, name);
+      *nexthop = (flags & RTF_GATEWAY) ? gw : daddr;
+    }
+  }
+
+  fclose(f);
+  return found;
+}
+
+/* Gets the MAC address of a complete entry on /proc/net/arp. */
+static int getNeighbour(in_addr_t addr, const char *iface, uint8_t *mac)
+{
+  char line[256], ip[16], hw[18], name[IFNAMSIZ];
+  unsigned flags;
+  int found;
+  FILE *f;
+
+  if ((f = fopen("/proc/net/arp", "r")) == NULL)
+    return FALSE;
+
+  found = FALSE;
+  while (!found && fgets(line, sizeof(line), f))
+  {
+    if (sscanf(line, "%15s %*x %x %17s %*s %15s", ip, &flags, hw, name) != 4)
+      continue;   /* header line. */
+
+    if ((flags & ATF_COM) && inet_addr(ip) == addr && !strcmp(name, iface))
+      found = sscanf(hw, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx",
+                     mac, mac+1, mac+2, mac+3, mac+4, mac+5) == ETH_ALEN;
+  }
+
+  fclose(f);
+  return found;
+}
@@ -0,0 +1,44 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <common.h>
+
+/* NOTE: Discards every packet. Used to measure how fast packets are generated
+         (--stats and the final summary still count them). */
+
+int null_open(const struct config_options * const __restrict__ co)
+{
+  return TRUE;
+}
+
+int null_send(const void * const buffer, size_t size, const struct config_options * const __restrict__ co)
+{
+  /* Keeps the compiler from optimizing the packet building away. */
+  __asm__ __volatile__("" : : "r"(buffer) : "memory");
+  return TRUE;
+}
+
+int null_flush(void)
+{
+  return TRUE;
+}
+
+void null_close(void)
+{
+}
@@ -0,0 +1,407 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <common.h>
+#include <pthread.h>
+
+/* NOTE: pcap and pcapng file backends.
+
+   Packets are written to --output ("-" is the standard output) instead of the
+   network. Each worker appends the records to its own PCAP_BUFFER_SIZE buffer
+   and writes it with a single write() when it's full, so there is one system
+   call per megabyte. The file is shared by all workers: It's opened (and the
+   file header written) by the first one, and the buffers are written under a
+   lock, so records never mix.
+
+   The packets are stored as raw IP (LINKTYPE_RAW) or, with --pcap-ether, after
+   an Ethernet header (destination --dst-mac, source 00:00:00:00:00:00).
+   Timestamps have nanosecond resolution on both formats. */
+
+#define PCAP_BUFFER_SIZE  (1024 * 1024)
+#define PCAP_SNAPLEN      65535
+
+#define LINKTYPE_ETHERNET 1
+#define LINKTYPE_RAW      101
+
+/* pcap, with nanosecond timestamps. */
+#define PCAP_MAGIC_NSEC   0xa1b23c4d
+
+struct pcap_file_header {
+  uint32_t magic;
+  uint16_t version_major;
+  uint16_t version_minor;
+  int32_t  thiszone;
+  uint32_t sigfigs;
+  uint32_t snaplen;
+  uint32_t linktype;
+};
+
+struct pcap_record {
+  uint32_t ts_sec;
+  uint32_t ts_nsec;
+  uint32_t caplen;
+  uint32_t len;
+};
+
+/* pcapng blocks, as needed here (see draft-ietf-opsawg-pcapng). */
+#define PCAPNG_SHB        0x0a0d0d0a
+#define PCAPNG_IDB        0x00000001
+#define PCAPNG_EPB        0x00000006
+#define PCAPNG_BYTE_ORDER 0x1a2b3c4d
+#define PCAPNG_IF_TSRESOL 9
+
+struct pcapng_shb {
+  uint32_t type;
+  uint32_t length;
+  uint32_t byte_order;
+  uint16_t version_major;
+  uint16_t version_minor;
+  int64_t  section_length;
+  uint32_t length2;
+} __attribute__((packed));
+
+struct pcapng_idb {
+  uint32_t type;
+  uint32_t length;
+  uint16_t linktype;
+  uint16_t reserved;
+  uint32_t snaplen;
+  uint16_t tsresol_code;          /* if_tsresol: 10^-9 s */
+  uint16_t tsresol_length;
+  uint8_t  tsresol;
+  uint8_t  tsresol_pad[3];
+  uint32_t end_of_options;
+  uint32_t length2;
+};
+
+struct pcapng_epb {
+  uint32_t type;
+  uint32_t length;
+  uint32_t interface_id;
+  uint32_t ts_high;
+  uint32_t ts_low;
+  uint32_t caplen;
+  uint32_t len;
+};
+
+/* The file, shared by all workers. */
+static int file_fd = -1;
+static int stdout_fd = -1;          /* see pcapStdout() */
+static unsigned file_users = 0;
+static int file_created = FALSE;    /* header written */
+static pthread_mutex_t file_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static __thread uint8_t *buffer = NULL;
+static __thread size_t used;
+static __thread int ether;
+static __thread struct ethhdr eth;
+
+static int writeAll(const void *, size_t);
+
+/* Copies the packet to its record at 'p', after the Ethernet header with
+   --pcap-ether. Returns where the packet starts. */
+static void *copyPacket(void *p, const void *packet, size_t size)
+{
+  struct iphdr *ip;
+
+  if (ether)
+  {
+    memcpy(p, &eth, ETH_HLEN);
+    p += ETH_HLEN;
+  }
+  memcpy(p, packet, size);
+
+  /* NOTE: There is no kernel to fill the IP checksum on this path. */
+  ip = p;
+  ip->check = 0;
+  ip->check = cksum(ip, ip->ihl * 4);
+
+  return p;
+}
+
+/* Keeps the standard output for the packets ("--output -"). Messages go to
+   the standard error from now on. */
+int pcapStdout(void)
+{
+  fflush(stdout);
+
+  if ((stdout_fd = dup(STDOUT_FILENO)) == -1 || dup2(STDERR_FILENO, STDOUT_FILENO) == -1)
+  {
+    perror("error redirecting standard output");
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* Opens the file (first worker only) and writes its header with 'header'.
+   NOTE: Workers may finish before others start, closing the file. It's
+         reopened for appending then. */
+static int openFile(const struct config_options * const __restrict__ co,
+                    int (*header)(int))
+{
+  int status = TRUE;
+
+  assert(co != NULL);
+  assert(co->output != NULL);
+
+  ether = co->pcap_ether;
+  if (ether)
+  {
+    memcpy(eth.h_dest, co->dst_mac, ETH_ALEN);
+    memset(eth.h_source, 0, ETH_ALEN);
+    eth.h_proto = htons(ETH_P_IP);
+  }
+
+  if ((buffer = malloc(PCAP_BUFFER_SIZE)) == NULL)
+  {
+    ERROR("Error allocating pcap buffer");
+    return FALSE;
+  }
+  used = 0;
+
+  pthread_mutex_lock(&file_mutex);
+  if (file_users++ == 0)
+  {
+    if (!strcmp(co->output, "-"))
+      file_fd = stdout_fd;
+    else if ((file_fd = open(co->output, file_created ? O_WRONLY | O_APPEND :
+                                         O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1)
+    {
+      perror("error opening output file");
+      status = FALSE;
+    }
+
+    if (status && !file_created)
+      status = file_created = header(ether ? LINKTYPE_ETHERNET : LINKTYPE_RAW);
+  }
+  else if (file_fd == -1)
+    status = FALSE;
+  pthread_mutex_unlock(&file_mutex);
+
+  return status;
+}
+
+/* Writes the buffer of this worker. */
+static int flushFile(void)
+{
+  int status;
+
+  if (used == 0)
+    return TRUE;
+
+  pthread_mutex_lock(&file_mutex);
+  status = writeAll(buffer, used);
+  pthread_mutex_unlock(&file_mutex);
+
+  used = 0;
+  return status;
+}
+
+static void closeFile(void)
+{
+  if (buffer == NULL)
+    return;
+
+  flushFile();
+  free(buffer);
+  buffer = NULL;
+
+  pthread_mutex_lock(&file_mutex);
+  if (--file_users == 0 && file_fd != -1)
+  {
+    if (file_fd != stdout_fd)
+      close(file_fd);
+    file_fd = -1;
+  }
+  pthread_mutex_unlock(&file_mutex);
+}
+
+/* NOTE: Must be called with file_mutex locked. */
+static int writeAll(const void *p, size_t size)
+{
+  ssize_t n;
+
+  while (size > 0)
+  {
+    if ((n = write(file_fd, p, size)) == -1)
+    {
+      if (errno == EINTR)
+        continue;
+
+      countSendError(errno, FALSE);
+      perror("error writing output file");
+      return FALSE;
+    }
+
+    p += n;
+    size -= n;
+  }
+
+  return TRUE;
+}
+
+/* Room for 'size' bytes on the buffer. */
+static inline void *reserve(size_t size)
+{
+  void *p;
+
+  if (used + size > PCAP_BUFFER_SIZE)
+    if (!flushFile())
+      return NULL;
+
+  p = buffer + used;
+  used += size;
+  return p;
+}
+
+static int pcapHeader(int linktype)
+{
+  struct pcap_file_header h = {
+    .magic         = PCAP_MAGIC_NSEC,
+    .version_major = 2,
+    .version_minor = 4,
+    .snaplen       = PCAP_SNAPLEN,
+    .linktype      = linktype
+  };
+
+  return writeAll(&h, sizeof(h));
+}
+
+int pcap_open(const struct config_options * const __restrict__ co)
+{
+  return openFile(co, pcapHeader);
+}
+
+int pcap_send(const void * const packet, size_t size, const struct config_options * const __restrict__ co)
+{
+  struct pcap_record *r;
+  struct timespec ts;
+  size_t len;
+
+  assert(packet != NULL);
+
+  len = size + (ether ? ETH_HLEN : 0);
+  if (len > PCAP_SNAPLEN)
+  {
+    ERROR("Packet is bigger than the pcap snapshot length.");
+    return FALSE;
+  }
+
+  if ((r = reserve(sizeof(struct pcap_record) + len)) == NULL)
+    return FALSE;
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+  r->ts_sec  = ts.tv_sec;
+  r->ts_nsec = ts.tv_nsec;
+  r->caplen  = r->len = len;
+
+  copyPacket(r + 1, packet, size);
+
+  return TRUE;
+}
+
+int pcap_flush(void)
+{
+  return flushFile();
+}
+
+void pcap_close(void)
+{
+  closeFile();
+}
+
+static int pcapngHeader(int linktype)
+{
+  struct pcapng_shb shb = {
+    .type           = PCAPNG_SHB,
+    .length         = sizeof(struct pcapng_shb),
+    .byte_order     = PCAPNG_BYTE_ORDER,
+    .version_major  = 1,
+    .version_minor  = 0,
+    .section_length = -1,
+    .length2        = sizeof(struct pcapng_shb)
+  };
+  struct pcapng_idb idb = {
+    .type           = PCAPNG_IDB,
+    .length         = sizeof(struct pcapng_idb),
+    .linktype       = linktype,
+    .snaplen        = PCAP_SNAPLEN,
+    .tsresol_code   = PCAPNG_IF_TSRESOL,
+    .tsresol_length = 1,
+    .tsresol        = 9,
+    .length2        = sizeof(struct pcapng_idb)
+  };
+
+  return writeAll(&shb, sizeof(shb)) && writeAll(&idb, sizeof(idb));
+}
+
+int pcapng_open(const struct config_options * const __restrict__ co)
+{
+  return openFile(co, pcapngHeader);
+}
+
+int pcapng_send(const void * const packet, size_t size, const struct config_options * const __restrict__ co)
+{
+  struct pcapng_epb *b;
+  struct timespec ts;
+  size_t len, padded;
+  uint64_t ns;
+  void *p;
+
+  assert(packet != NULL);
+
+  len = size + (ether ? ETH_HLEN : 0);
+  if (len > PCAP_SNAPLEN)
+  {
+    ERROR("Packet is bigger than the pcap snapshot length.");
+    return FALSE;
+  }
+
+  /* Data is padded to 32 bits and followed by the block length again. */
+  padded = (len + 3) & ~3;
+  if ((b = reserve(sizeof(struct pcapng_epb) + padded + 4)) == NULL)
+    return FALSE;
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+  ns = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+  b->type         = PCAPNG_EPB;
+  b->length       = sizeof(struct pcapng_epb) + padded + 4;
+  b->interface_id = 0;
+  b->ts_high      = ns >> 32;
+  b->ts_low       = ns;
+  b->caplen       = b->len = len;
+
+  p = copyPacket(b + 1, packet, size);
+  memset(p + size, 0, padded - len);
+  memcpy(p + size + (padded - len), &b->length, 4);
+
+  return TRUE;
+}
+
+int pcapng_flush(void)
+{
+  return flushFile();
+}
+
+void pcapng_close(void)
+{
+  closeFile();
+}
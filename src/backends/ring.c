@@ -0,0 +1,239 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <common.h>
+#include <sys/mman.h>
+#include <linux/if_packet.h>
+
+/* Ring geometry: frames are sized after the interface MTU,
+   but the whole ring never takes more than RING_MEMORY bytes. */
+#define RING_FRAMES           4096
+#define RING_MEMORY           (16 * 1024 * 1024)
+#define RING_FRAMES_PER_BLOCK 8
+
+/* Offset of the frame data. See packet_mmap.txt on kernel documentation. */
+#define RING_DATA_OFFSET (TPACKET2_HDRLEN - sizeof(struct sockaddr_ll))
+
+static __thread socket_t fd = -1;
+static __thread void *ring = MAP_FAILED;
+static __thread size_t ring_size;
+static __thread unsigned frame_size, frame_nr, frame_idx;
+static __thread unsigned batch_size, pending;
+static __thread size_t max_packet_size;
+static __thread struct ethhdr eth;   /* Ethernet header copied to every frame. */
+
+static int kickRing(int);
+
+/* Opens an AF_PACKET socket with a TPACKET_V2 TX ring bound to the output interface. */
+int ring_open(const struct config_options * const __restrict__ co)
+{
+  struct link_info li;
+  struct tpacket_req req = {};
+  struct sockaddr_ll sll = {};
+  unsigned needed;
+  int n;
+
+  assert(co != NULL);
+
+  if (!getLinkInfo(co, &li))
+    return FALSE;
+
+  /* Protocol 0: This socket will never receive anything. */
+  if ((fd = socket(AF_PACKET, SOCK_RAW, 0)) == -1)
+  {
+    perror("error opening packet socket");
+    return FALSE;
+  }
+
+  n = TPACKET_V2;
+  if (setsockopt(fd, SOL_PACKET, PACKET_VERSION, &n, sizeof(n)) == -1)
+  {
+    perror("error setting TPACKET_V2");
+    goto error;
+  }
+
+  /* Malformed frames are discarded instead of stopping the ring. */
+  n = 1;
+  if (setsockopt(fd, SOL_PACKET, PACKET_LOSS, &n, sizeof(n)) == -1)
+  {
+    perror("error setting packet loss");
+    goto error;
+  }
+
+  if (co->qdisc_bypass)
+    if (setsockopt(fd, SOL_PACKET, PACKET_QDISC_BYPASS, &n, sizeof(n)) == -1)
+    {
+      perror("error setting qdisc bypass");
+      goto error;
+    }
+
+  /* Frames (power of 2) big enough to hold an MTU sized packet. */
+  needed = RING_DATA_OFFSET + ETH_HLEN + li.mtu;
+  for (frame_size = 2048; frame_size < needed; frame_size <<= 1);
+
+  frame_nr = RING_MEMORY / frame_size;
+  if (frame_nr > RING_FRAMES)
+    frame_nr = RING_FRAMES;
+  frame_nr &= ~(RING_FRAMES_PER_BLOCK - 1);
+  if (frame_nr == 0)
+    frame_nr = RING_FRAMES_PER_BLOCK;
+
+  /* NOTE: Since the blocks hold an exact number of frames, frames are contiguous. */
+  req.tp_frame_size = frame_size;
+  req.tp_block_size = frame_size * RING_FRAMES_PER_BLOCK;
+  req.tp_block_nr   = frame_nr / RING_FRAMES_PER_BLOCK;
+  req.tp_frame_nr   = frame_nr;
+
+  if (setsockopt(fd, SOL_PACKET, PACKET_TX_RING, &req, sizeof(req)) == -1)
+  {
+    perror("error setting TX ring");
+    goto error;
+  }
+
+  ring_size = (size_t)req.tp_block_size * req.tp_block_nr;
+  if ((ring = mmap(NULL, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+  {
+    perror("error mapping TX ring");
+    goto error;
+  }
+
+  sll.sll_family   = AF_PACKET;
+  sll.sll_protocol = htons(ETH_P_IP);
+  sll.sll_ifindex  = li.ifindex;
+  if (bind(fd, (struct sockaddr *)&sll, sizeof(sll)) == -1)
+  {
+    perror("error binding packet socket");
+    goto error;
+  }
+
+  memcpy(eth.h_dest, li.dst_mac, ETH_ALEN);
+  memcpy(eth.h_source, li.src_mac, ETH_ALEN);
+  eth.h_proto = htons(ETH_P_IP);
+
+  max_packet_size = li.mtu;
+  batch_size = co->batch;
+  frame_idx = pending = 0;
+
+  return TRUE;
+
+error:
+  if (ring != MAP_FAILED)
+    munmap(ring, ring_size);
+  ring = MAP_FAILED;
+
+  close(fd);
+  fd = -1;
+  return FALSE;
+}
+
+/* Copies the packet to the next free frame. The ring is flushed every 'batch' frames. */
+int ring_send(const void * const buffer, size_t size, const struct config_options * const __restrict__ co)
+{
+  struct tpacket2_hdr *hdr;
+  struct iphdr *ip;
+  void *data;
+
+  assert(buffer != NULL);
+  assert(size > 0);
+
+  if (size > max_packet_size)
+  {
+    ERROR("Packet is bigger than the interface MTU.");
+    return FALSE;
+  }
+
+  hdr = ring + (size_t)frame_idx * frame_size;
+
+  /* Frame still owned by the kernel: The ring is full. Wait for it to be drained. */
+  if (__atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE) != TP_STATUS_AVAILABLE)
+  {
+    if (!kickRing(0))
+      return FALSE;
+
+    if (__atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE) != TP_STATUS_AVAILABLE)
+    {
+      ERROR("TX ring frame not released by the kernel.");
+      return FALSE;
+    }
+  }
+
+  data = (void *)hdr + RING_DATA_OFFSET;
+  memcpy(data, &eth, ETH_HLEN);
+  memcpy(data + ETH_HLEN, buffer, size);
+
+  /* NOTE: There is no kernel to fill the IP checksum on this path. */
+  ip = data + ETH_HLEN;
+  ip->check = 0;
+  ip->check = cksum(ip, ip->ihl * 4);
+
+  hdr->tp_len = ETH_HLEN + size;
+  __atomic_store_n(&hdr->tp_status, TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE);
+
+  if (++frame_idx == frame_nr)
+    frame_idx = 0;
+
+  /* Don't wait for the frames to be sent, we have more to fill. */
+  if (++pending >= batch_size)
+    return kickRing(MSG_DONTWAIT);
+
+  return TRUE;
+}
+
+/* Sends all pending frames and waits for their transmission. */
+int ring_flush(void)
+{
+  return kickRing(0);
+}
+
+void ring_close(void)
+{
+  if (ring != MAP_FAILED)
+    munmap(ring, ring_size);
+  ring = MAP_FAILED;
+
+  if (fd != -1)
+    close(fd);
+  fd = -1;
+}
+
+/* Asks the kernel to transmit all frames marked with TP_STATUS_SEND_REQUEST.
+   Without MSG_DONTWAIT the call only returns after all of them are sent. */
+static int kickRing(int flags)
+{
+  int num_tries;
+
+  for (num_tries = MAX_SENDTO_TRIES; num_tries--;)
+  {
+    if (send(fd, NULL, 0, flags) != -1)
+    {
+      pending = 0;
+      return TRUE;
+    }
+
+    /* With MSG_DONTWAIT the kernel may still be busy with the previous kick. */
+    if (errno == EAGAIN && (flags & MSG_DONTWAIT))
+      return TRUE;
+
+    if (!retrySend(&num_tries))
+      break;
+  }
+
+  ERROR("Error sending TX ring frames.");
+  return FALSE;
+}
@@ -0,0 +1,432 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <common.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+/* NOTE: liburing isn't required. The few system calls needed are called directly. */
+#define io_uring_setup(e,p)          syscall(__NR_io_uring_setup, (e), (p))
+#define io_uring_enter(f,s,c,fl)     syscall(__NR_io_uring_enter, (f), (s), (c), (fl), NULL, 0)
+
+/* A packet being sent. Everything sendmsg() looks at must live until its completion. */
+struct uring_slot {
+  struct msghdr       msg;
+  struct iovec        iov;
+  struct sockaddr_in  sin;
+  void               *buffer;
+  int                 num_tries;  /* sends left, as in retrySend() */
+};
+
+/* Per batch counters, shown when the backend is closed. */
+struct uring_stats {
+  uint64_t batches;               /* io_uring_enter() calls submitting SQEs */
+  uint64_t submitted;             /* SQEs accepted by the kernel            */
+  uint64_t completed;             /* CQEs reaped                            */
+  uint64_t reaps;                 /* times CQEs were found                  */
+  uint64_t retried;               /* sends resubmitted (see retrySend())    */
+  uint64_t waits;                 /* times we had to wait for a completion  */
+  unsigned max_submitted;         /* biggest batch submitted                */
+  unsigned max_completed;         /* most CQEs reaped at once               */
+};
+
+static __thread socket_t fd = -1;
+static __thread int ring_fd = -1;
+
+/* Submission and completion rings. */
+static __thread void *sq_map = MAP_FAILED, *cq_map = MAP_FAILED;
+static __thread size_t sq_map_size, cq_map_size;
+static __thread struct io_uring_sqe *sqes = MAP_FAILED;
+static __thread unsigned *sq_tail, *sq_array, sq_mask, sq_entries;
+static __thread unsigned *cq_head, *cq_tail, cq_mask;
+static __thread struct io_uring_cqe *cqes;
+
+/* Packet slots. There are as many slots as CQEs, so the completion ring never overflows. */
+static __thread struct uring_slot *slots = NULL;
+static __thread void *slots_buffer = NULL;
+static __thread size_t slot_size;
+static __thread unsigned *free_slots, free_count, slots_count;
+static __thread unsigned *retry_slots;
+
+static __thread unsigned batch_size, pending;
+static __thread struct uring_stats stats;
+
+static int  submitBatch(unsigned);
+static int  reapCompletions(void);
+static int  queueSend(unsigned);
+static int  allocSlots(size_t);
+
+/* Creates the raw socket and the io_uring instance. */
+int uring_open(const struct config_options * const __restrict__ co)
+{
+  struct io_uring_params p = {};
+  unsigned entries;
+
+  assert(co != NULL);
+
+  if ((fd = openRawSocket()) == -1)
+    return FALSE;
+
+  /* SQ is big enough for a whole batch. */
+  batch_size = co->batch;
+  for (entries = 8; entries < batch_size; entries <<= 1);
+
+  if ((ring_fd = io_uring_setup(entries, &p)) == -1)
+  {
+    perror("error creating io_uring");
+    return FALSE;
+  }
+
+  sq_map_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  cq_map_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+
+  /* NOTE: Newer kernels map both rings at once. */
+  if (p.features & IORING_FEAT_SINGLE_MMAP)
+  {
+    if (cq_map_size > sq_map_size)
+      sq_map_size = cq_map_size;
+    cq_map_size = sq_map_size;
+  }
+
+  sq_map = mmap(NULL, sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+  if (sq_map == MAP_FAILED)
+  {
+    perror("error mapping io_uring");
+    return FALSE;
+  }
+
+  if (p.features & IORING_FEAT_SINGLE_MMAP)
+    cq_map = sq_map;
+  else if ((cq_map = mmap(NULL, cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          ring_fd, IORING_OFF_CQ_RING)) == MAP_FAILED)
+  {
+    perror("error mapping io_uring");
+    return FALSE;
+  }
+
+  sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+              MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED)
+  {
+    perror("error mapping io_uring");
+    return FALSE;
+  }
+
+  sq_tail    = sq_map + p.sq_off.tail;
+  sq_array   = sq_map + p.sq_off.array;
+  sq_mask    = *(unsigned *)(sq_map + p.sq_off.ring_mask);
+  sq_entries = p.sq_entries;
+  cq_head    = cq_map + p.cq_off.head;
+  cq_tail    = cq_map + p.cq_off.tail;
+  cq_mask    = *(unsigned *)(cq_map + p.cq_off.ring_mask);
+  cqes       = cq_map + p.cq_off.cqes;
+
+  slots_count = p.cq_entries;
+  if (!allocSlots(INITIAL_PACKET_SIZE))
+    return FALSE;
+
+  pending = 0;
+  memset(&stats, 0, sizeof(stats));
+
+  return TRUE;
+}
+
+/* Copies the packet to a free slot and queues a sendmsg() SQE for it.
+   The SQEs are submitted every 'batch' packets. */
+int uring_send(const void * const buffer, size_t size, const struct config_options * const __restrict__ co)
+{
+  struct uring_slot *slot;
+  unsigned idx;
+
+  assert(buffer != NULL);
+  assert(size > 0);
+  assert(co != NULL);
+
+  /* NOTE: Bigger packets only happen when options change between modules (T50 protocol).
+           Wait for all slots to complete and grow them. */
+  if (size > slot_size)
+    if (!uring_flush() || !allocSlots(size))
+      return FALSE;
+
+  /* All slots in flight: Wait for, at least, one of them. */
+  while (free_count == 0)
+  {
+    if (pending && !submitBatch(0))
+      return FALSE;
+
+    if (!reapCompletions())
+      return FALSE;
+
+    if (free_count == 0)
+    {
+      stats.waits++;
+      if (!submitBatch(1))
+        return FALSE;
+    }
+  }
+
+  idx = free_slots[--free_count];
+  slot = &slots[idx];
+
+  memcpy(slot->buffer, buffer, size);
+  slot->iov.iov_len = size;
+  slot->sin.sin_port = htons(IPPORT_RND(co->dest));
+  slot->sin.sin_addr.s_addr = co->ip.daddr;
+  slot->num_tries = MAX_SENDTO_TRIES - 1;
+
+  if (!queueSend(idx))
+    return FALSE;
+
+  if (pending >= batch_size)
+    return submitBatch(0) && reapCompletions();
+
+  return TRUE;
+}
+
+/* Submits the queued SQEs and waits for all packets in flight. */
+int uring_flush(void)
+{
+  while (pending || free_count < slots_count)
+  {
+    if (!submitBatch(pending ? 0 : 1))
+      return FALSE;
+
+    if (!reapCompletions())
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+void uring_close(void)
+{
+  if (stats.batches)
+    fprintf(stderr,
+            "%s: io_uring: %llu batches, %llu submitted (%.1f/batch, max %u), "
+            "%llu completed (%.1f/reap, max %u), %llu retried, %llu waits\n",
+            PACKAGE,
+            (unsigned long long)stats.batches,
+            (unsigned long long)stats.submitted,
+            (double)stats.submitted / stats.batches,
+            stats.max_submitted,
+            (unsigned long long)stats.completed,
+            stats.reaps ? (double)stats.completed / stats.reaps : 0.0,
+            stats.max_completed,
+            (unsigned long long)stats.retried,
+            (unsigned long long)stats.waits);
+  memset(&stats, 0, sizeof(stats));
+
+  if (sqes != MAP_FAILED)
+    munmap(sqes, sq_entries * sizeof(struct io_uring_sqe));
+  if (cq_map != MAP_FAILED && cq_map != sq_map)
+    munmap(cq_map, cq_map_size);
+  if (sq_map != MAP_FAILED)
+    munmap(sq_map, sq_map_size);
+  sqes = MAP_FAILED;
+  sq_map = cq_map = MAP_FAILED;
+
+  if (ring_fd != -1)
+    close(ring_fd);
+  ring_fd = -1;
+
+  if (fd != -1)
+    close(fd);
+  fd = -1;
+
+  free(slots);
+  free(slots_buffer);
+  free(free_slots);
+  free(retry_slots);
+  slots = NULL;
+  slots_buffer = NULL;
+  free_slots = NULL;
+  retry_slots = NULL;
+}
+
+/* Fills the next SQE with a sendmsg() of slot 'idx'. Submits the queue if it's full. */
+static int queueSend(unsigned idx)
+{
+  struct io_uring_sqe *sqe;
+  unsigned tail;
+
+  if (pending == sq_entries)
+    if (!submitBatch(0))
+      return FALSE;
+
+  tail = *sq_tail;
+  sqe = &sqes[tail & sq_mask];
+  memset(sqe, 0, sizeof(struct io_uring_sqe));
+  sqe->opcode    = IORING_OP_SENDMSG;
+  sqe->fd        = fd;
+  sqe->addr      = (uintptr_t)&slots[idx].msg;
+  sqe->len       = 1;
+  sqe->msg_flags = MSG_NOSIGNAL;
+  sqe->user_data = idx;
+  sq_array[tail & sq_mask] = tail & sq_mask;
+
+  __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+  pending++;
+
+  return TRUE;
+}
+
+/* Submits all pending SQEs. If 'wait' isn't zero, waits for that many completions. */
+static int submitBatch(unsigned wait)
+{
+  int ret, num_tries;
+
+  for (num_tries = MAX_SENDTO_TRIES; num_tries--;)
+  {
+    ret = io_uring_enter(ring_fd, pending, wait, wait ? IORING_ENTER_GETEVENTS : 0);
+
+    if (ret != -1)
+      break;
+
+    /* NOTE: EBUSY can't be a CQ overflow, since there are no more slots than CQEs. */
+    if (errno == EBUSY)
+      errno = EAGAIN;
+
+    if (!retrySend(&num_tries))
+      break;
+  }
+
+  if (ret == -1)
+  {
+    perror("error submitting to io_uring");
+    return FALSE;
+  }
+
+  if (ret > 0)
+  {
+    stats.batches++;
+    stats.submitted += ret;
+    if ((unsigned)ret > stats.max_submitted)
+      stats.max_submitted = ret;
+  }
+
+  pending -= ret;
+  return TRUE;
+}
+
+/* Frees the slots of all completed sends. Failed sends are resent, as the raw socket
+   does: retrySend() decides which errors are retried, and waits before it, and each
+   slot gives up after MAX_SENDTO_TRIES tries. */
+static int reapCompletions(void)
+{
+  unsigned head, tail, count, retries, i;
+  struct io_uring_cqe *cqe;
+  struct uring_slot *slot;
+
+  head = *cq_head;
+  tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+
+  for (count = retries = 0; head != tail; head++, count++)
+  {
+    cqe = &cqes[head & cq_mask];
+
+    if (cqe->res < 0)
+    {
+      /* Slot stays in flight. It's resent below. */
+      slot = &slots[cqe->user_data];
+      errno = -cqe->res;
+
+      if (slot->num_tries > 0 && retrySend(&slot->num_tries))
+      {
+        slot->num_tries--;
+        retry_slots[retries++] = cqe->user_data;
+        continue;
+      }
+
+      perror("error sending packet");
+      return FALSE;
+    }
+
+    free_slots[free_count++] = cqe->user_data;
+  }
+
+  __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+
+  if (count)
+  {
+    stats.reaps++;
+    stats.completed += count - retries;
+    stats.retried += retries;
+    if (count > stats.max_completed)
+      stats.max_completed = count;
+  }
+
+  /* NOTE: queueSend() may reap again, so this is done after the CQ head is updated. */
+  for (i = 0; i < retries; i++)
+    if (!queueSend(retry_slots[i]))
+      return FALSE;
+
+  return TRUE;
+}
+
+/* (Re)allocates the slots, 'size' bytes each.
+   NOTE: Must be called with no slots in flight. */
+static int allocSlots(size_t size)
+{
+  unsigned i;
+  void *p;
+
+  /* Keep the buffers aligned to cache lines. */
+  size = (size + 63) & ~(size_t)63;
+
+  if (slots == NULL)
+  {
+    slots = calloc(slots_count, sizeof(struct uring_slot));
+    free_slots = calloc(slots_count, sizeof(unsigned));
+    retry_slots = calloc(slots_count, sizeof(unsigned));
+
+    if (slots == NULL || free_slots == NULL || retry_slots == NULL)
+    {
+      ERROR("Error allocating io_uring slots");
+      return FALSE;
+    }
+  }
+
+  if ((p = realloc(slots_buffer, slots_count * size)) == NULL)
+  {
+    ERROR("Error allocating io_uring slots");
+    return FALSE;
+  }
+
+  slots_buffer = p;
+  slot_size = size;
+
+  for (i = 0; i < slots_count; i++)
+  {
+    slots[i].buffer = slots_buffer + i * size;
+
+    slots[i].iov.iov_base = slots[i].buffer;
+    slots[i].sin.sin_family = AF_INET;
+
+    slots[i].msg.msg_name    = &slots[i].sin;
+    slots[i].msg.msg_namelen = sizeof(struct sockaddr_in);
+    slots[i].msg.msg_iov     = &slots[i].iov;
+    slots[i].msg.msg_iovlen  = 1;
+
+    free_slots[i] = i;
+  }
+  free_count = slots_count;
+
+  return TRUE;
+}
@@ -0,0 +1,391 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <common.h>
+#include <sys/mman.h>
+#include <linux/if_xdp.h>
+
+/* UMEM geometry. The TX and completion rings hold all frames, so a free
+   frame always has a TX descriptor waiting for it. */
+#define XDP_NUM_FRAMES  4096
+#define XDP_FILL_SIZE   64    /* Never used for TX, but the kernel requires it. */
+
+/* A single producer/consumer ring shared with the kernel. */
+struct xdp_ring {
+  uint32_t *producer;
+  uint32_t *consumer;
+  uint32_t *flags;
+  void     *desc;
+  uint32_t  mask;
+  void     *map;
+  size_t    map_size;
+};
+
+static __thread socket_t fd = -1;
+static __thread void *umem = MAP_FAILED;
+static __thread size_t umem_size;
+static __thread unsigned frame_size;
+static __thread struct xdp_ring tx, cq, fq;
+static __thread int need_wakeup;
+static __thread unsigned batch_size, pending;
+static __thread size_t max_packet_size;
+static __thread struct ethhdr eth;   /* Ethernet header copied to every frame. */
+
+/* Stack of UMEM frames not owned by the kernel. */
+static __thread uint64_t free_frames[XDP_NUM_FRAMES];
+static __thread unsigned free_count;
+static __thread uint64_t current_frame = (uint64_t)-1;   /* frame where the packet is being built */
+
+static int  mapRing(struct xdp_ring *, struct xdp_ring_offset *, off_t, size_t, unsigned);
+static void unmapRing(struct xdp_ring *);
+static void reclaimFrames(void);
+static int  kickTx(int);
+
+/* Opens an AF_XDP socket, bound to the output interface's queue 'co->queue'.
+   Zero copy mode is tried first. */
+int xdp_open(const struct config_options * const __restrict__ co)
+{
+  struct link_info li;
+  struct xdp_umem_reg reg = {};
+  struct xdp_mmap_offsets off;
+  struct sockaddr_xdp sxdp = {};
+  socklen_t len;
+  unsigned n;
+
+  assert(co != NULL);
+
+  if (!getLinkInfo(co, &li))
+    return FALSE;
+
+  /* Frames (power of 2) big enough to hold an MTU sized packet plus the pseudo header
+     modules append past its end. */
+  frame_size = (ETH_HLEN + li.mtu + 64 <= 2048) ? 2048 : 4096;
+  if (ETH_HLEN + li.mtu + 64 > frame_size)
+  {
+    ERROR("Interface MTU is too big for AF_XDP frames.");
+    return FALSE;
+  }
+
+  if ((fd = socket(AF_XDP, SOCK_RAW, 0)) == -1)
+  {
+    perror("error opening AF_XDP socket");
+    return FALSE;
+  }
+
+  umem_size = (size_t)XDP_NUM_FRAMES * frame_size;
+  if ((umem = mmap(NULL, umem_size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0)) == MAP_FAILED)
+  {
+    perror("error allocating UMEM");
+    goto error;
+  }
+
+  reg.addr = (uintptr_t)umem;
+  reg.len = umem_size;
+  reg.chunk_size = frame_size;
+  if (setsockopt(fd, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) == -1)
+  {
+    perror("error registering UMEM");
+    goto error;
+  }
+
+  n = XDP_FILL_SIZE;
+  if (setsockopt(fd, SOL_XDP, XDP_UMEM_FILL_RING, &n, sizeof(n)) == -1)
+  {
+    perror("error setting fill ring");
+    goto error;
+  }
+
+  n = XDP_NUM_FRAMES;
+  if (setsockopt(fd, SOL_XDP, XDP_UMEM_COMPLETION_RING, &n, sizeof(n)) == -1 ||
+      setsockopt(fd, SOL_XDP, XDP_TX_RING, &n, sizeof(n)) == -1)
+  {
+    perror("error setting TX rings");
+    goto error;
+  }
+
+  len = sizeof(off);
+  if (getsockopt(fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &len) == -1)
+  {
+    perror("error getting ring offsets");
+    goto error;
+  }
+
+  if (!mapRing(&tx, &off.tx, XDP_PGOFF_TX_RING, sizeof(struct xdp_desc), XDP_NUM_FRAMES) ||
+      !mapRing(&cq, &off.cr, XDP_UMEM_PGOFF_COMPLETION_RING, sizeof(uint64_t), XDP_NUM_FRAMES) ||
+      !mapRing(&fq, &off.fr, XDP_UMEM_PGOFF_FILL_RING, sizeof(uint64_t), XDP_FILL_SIZE))
+    goto error;
+
+  sxdp.sxdp_family   = AF_XDP;
+  sxdp.sxdp_ifindex  = li.ifindex;
+  sxdp.sxdp_queue_id = co->queue;
+  sxdp.sxdp_flags    = XDP_ZEROCOPY | XDP_USE_NEED_WAKEUP;
+  if (bind(fd, (struct sockaddr *)&sxdp, sizeof(sxdp)) == -1)
+  {
+    /* NOTE: Most drivers (veth included) cannot do zero copy. The kernel copies
+             the frames from UMEM, but still without going through the stack. */
+    sxdp.sxdp_flags = XDP_COPY | XDP_USE_NEED_WAKEUP;
+    if (bind(fd, (struct sockaddr *)&sxdp, sizeof(sxdp)) == -1)
+    {
+      /* NOTE: Each worker thread uses its own queue (see worker.c). */
+      if (errno == EINVAL)
+        fprintf(stderr, "%s: cannot bind AF_XDP socket to queue %u of %s (one queue per thread is needed)\n",
+                PACKAGE, co->queue, li.name);
+      else
+        perror("error binding AF_XDP socket");
+      goto error;
+    }
+  }
+
+  /* NOTE: In copy mode the frames are only sent by sendto(), so always kick. */
+  need_wakeup = (sxdp.sxdp_flags & XDP_ZEROCOPY) != 0;
+
+  for (free_count = 0; free_count < XDP_NUM_FRAMES; free_count++)
+    free_frames[free_count] = (uint64_t)free_count * frame_size;
+  current_frame = (uint64_t)-1;
+
+  memcpy(eth.h_dest, li.dst_mac, ETH_ALEN);
+  memcpy(eth.h_source, li.src_mac, ETH_ALEN);
+  eth.h_proto = htons(ETH_P_IP);
+
+  max_packet_size = li.mtu;
+  batch_size = co->batch;
+  pending = 0;
+
+  return TRUE;
+
+error:
+  xdp_close();
+  return FALSE;
+}
+
+/* Gives the modules a free UMEM frame to build the next packet in, leaving room
+   for the Ethernet header. Returns NULL if no frame is released by the kernel. */
+void *xdp_buffer(size_t *size)
+{
+  int num_tries;
+
+  assert(size != NULL);
+
+  /* The previous packet was not sent (ex: too big). Reuse its frame. */
+  if (current_frame != (uint64_t)-1)
+    goto done;
+
+  for (num_tries = MAX_SENDTO_TRIES; free_count == 0 && num_tries--;)
+  {
+    reclaimFrames();
+
+    if (free_count == 0)
+    {
+      if (!kickTx(TRUE))
+        return NULL;
+
+      /* NOTE: In zero copy mode, frames only complete after the NIC sends them. */
+      reclaimFrames();
+      if (free_count == 0)
+        backoffSend(num_tries);
+    }
+  }
+
+  if (free_count == 0)
+  {
+    ERROR("No AF_XDP frame released by the kernel.");
+    return NULL;
+  }
+
+  current_frame = free_frames[--free_count];
+
+done:
+  *size = frame_size - ETH_HLEN;
+  return umem + current_frame + ETH_HLEN;
+}
+
+/* Posts the packet to the TX ring. The kernel is kicked every 'batch' packets. */
+int xdp_send(const void * const buffer, size_t size, const struct config_options * const __restrict__ co)
+{
+  struct xdp_desc *desc;
+  struct iphdr *ip;
+  uint32_t prod;
+  void *frame;
+  size_t n;
+
+  assert(buffer != NULL);
+  assert(size > 0);
+
+  if (size > max_packet_size)
+  {
+    ERROR("Packet is bigger than the interface MTU.");
+    return FALSE;
+  }
+
+  /* Packets not built on UMEM (by xdp_buffer()) are copied. */
+  if (current_frame == (uint64_t)-1 || buffer != umem + current_frame + ETH_HLEN)
+  {
+    if (xdp_buffer(&n) == NULL)
+      return FALSE;
+    memcpy(umem + current_frame + ETH_HLEN, buffer, size);
+  }
+
+  frame = umem + current_frame;
+  memcpy(frame, &eth, ETH_HLEN);
+
+  /* NOTE: There is no kernel to fill the IP checksum on this path. */
+  ip = frame + ETH_HLEN;
+  ip->check = 0;
+  ip->check = cksum(ip, ip->ihl * 4);
+
+  /* NOTE: Since the TX ring has a slot for every frame, there is always room here. */
+  prod = *tx.producer;
+  desc = (struct xdp_desc *)tx.desc + (prod & tx.mask);
+  desc->addr    = current_frame;
+  desc->len     = ETH_HLEN + size;
+  desc->options = 0;
+  __atomic_store_n(tx.producer, prod + 1, __ATOMIC_RELEASE);
+
+  current_frame = (uint64_t)-1;
+
+  if (++pending >= batch_size)
+    return kickTx(FALSE);
+
+  return TRUE;
+}
+
+/* Sends all posted packets and waits for their completion. */
+int xdp_flush(void)
+{
+  int num_tries;
+
+  for (num_tries = MAX_SENDTO_TRIES; num_tries--;)
+  {
+    if (!kickTx(TRUE))
+      return FALSE;
+
+    reclaimFrames();
+    if (free_count + (current_frame != (uint64_t)-1) == XDP_NUM_FRAMES)
+      return TRUE;
+
+    backoffSend(num_tries);
+  }
+
+  ERROR("AF_XDP frames not completed by the kernel.");
+  return FALSE;
+}
+
+void xdp_close(void)
+{
+  unmapRing(&tx);
+  unmapRing(&cq);
+  unmapRing(&fq);
+
+  if (umem != MAP_FAILED)
+    munmap(umem, umem_size);
+  umem = MAP_FAILED;
+
+  if (fd != -1)
+    close(fd);
+  fd = -1;
+}
+
+static int mapRing(struct xdp_ring *ring, struct xdp_ring_offset *off, off_t pgoff, size_t desc_size, unsigned entries)
+{
+  ring->map_size = off->desc + entries * desc_size;
+  if ((ring->map = mmap(NULL, ring->map_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, fd, pgoff)) == MAP_FAILED)
+  {
+    ring->map = NULL;
+    perror("error mapping AF_XDP ring");
+    return FALSE;
+  }
+
+  ring->producer = ring->map + off->producer;
+  ring->consumer = ring->map + off->consumer;
+  ring->flags    = ring->map + off->flags;
+  ring->desc     = ring->map + off->desc;
+  ring->mask     = entries - 1;
+
+  return TRUE;
+}
+
+static void unmapRing(struct xdp_ring *ring)
+{
+  if (ring->map != NULL)
+    munmap(ring->map, ring->map_size);
+  ring->map = NULL;
+}
+
+/* Moves the frames already sent from the completion ring to the free frames stack. */
+static void reclaimFrames(void)
+{
+  uint32_t cons, prod;
+
+  cons = *cq.consumer;
+  prod = __atomic_load_n(cq.producer, __ATOMIC_ACQUIRE);
+
+  for (; cons != prod; cons++)
+    free_frames[free_count++] = ((uint64_t *)cq.desc)[cons & cq.mask];
+
+  __atomic_store_n(cq.consumer, cons, __ATOMIC_RELEASE);
+}
+
+/* Asks the kernel to send the posted descriptors. If 'wait' is TRUE, keeps asking
+   until the kernel has consumed all of them. */
+static int kickTx(int wait)
+{
+  int num_tries, waited;
+
+  pending = 0;
+
+  for (num_tries = MAX_SENDTO_TRIES; num_tries--;)
+  {
+    uint32_t cons = __atomic_load_n(tx.consumer, __ATOMIC_ACQUIRE);
+
+    if (cons == *tx.producer)
+      return TRUE;
+
+    waited = FALSE;
+    if (!need_wakeup || (__atomic_load_n(tx.flags, __ATOMIC_RELAXED) & XDP_RING_NEED_WAKEUP))
+      if (sendto(fd, NULL, 0, MSG_DONTWAIT, NULL, 0) == -1)
+      {
+        /* EAGAIN: The kernel sends a limited number of frames per call. EBUSY: It's
+           still busy with a previous call. Both are fine, unless we are waiting: Then
+           they are retried (and backed off) as any other send. */
+        if (errno == EBUSY)
+          errno = EAGAIN;
+        waited = wait && (errno == EAGAIN || errno == ENOBUFS);
+
+        if ((wait || errno != EAGAIN) && !retrySend(&num_tries))
+        {
+          ERROR("Error sending AF_XDP frames.");
+          return FALSE;
+        }
+      }
+
+    if (!wait)
+      return TRUE;
+
+    /* Only calls without progress count against the tries. */
+    if (__atomic_load_n(tx.consumer, __ATOMIC_ACQUIRE) != cons)
+      num_tries = MAX_SENDTO_TRIES;
+    else if (!waited)
+      backoffSend(num_tries);
+  }
+
+  ERROR("AF_XDP frames not sent by the kernel.");
+  return FALSE;
+}
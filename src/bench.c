@@ -0,0 +1,250 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <common.h>
+#include <protocol/gre.h>
+#include <protocol/tcp_options.h>
+#include <protocol/rsvp.h>
+#include <protocol/ospf.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC
+#endif
+
+/* NOTE: Generation benchmark (--bench).
+
+   Every module used (all of them, for T50) builds packets for a while, with the
+   command line options and with the variants below, and nothing is sent. Each
+   variant is timed calling the module and, if it has a template, through the
+   template. The best of BENCH_ROUNDS rounds is shown, so the noise of other
+   processes only makes the rounds slower. */
+
+#define BENCH_PACKETS 1000        /* packets per round          */
+#define BENCH_ROUNDS  50
+
+typedef struct {
+  char *module;                   /* acronym (NULL: every module) */
+  char *name;
+  void (*set)(struct config_options *, int);
+  int   arg;
+} bench_variant_t;
+
+static void setNothing(struct config_options *co, int arg)
+{
+}
+
+static void setGre(struct config_options *co, int arg)
+{
+  co->encapsulated = TRUE;
+  co->gre.options |= arg;
+  co->gre.S = !!(arg & GRE_OPTION_SEQUENCE);
+  co->gre.K = !!(arg & GRE_OPTION_KEY);
+  co->gre.C = !!(arg & GRE_OPTION_CHECKSUM);
+}
+
+static void setTcpOptions(struct config_options *co, int arg)
+{
+  /* The usual SYN options. All of them don't fit on a TCP header. */
+  co->tcp.options |= TCP_OPTION_MSS | TCP_OPTION_WSOPT | TCP_OPTION_TSOPT | TCP_OPTION_SACK_OK;
+  co->tcp.nop = TCPOPT_NOP;
+}
+
+static void setTcpAuth(struct config_options *co, int arg)
+{
+  co->tcp.md5  = arg;
+  co->tcp.auth = !arg;
+}
+
+static void setRipAuth(struct config_options *co, int arg)
+{
+  co->rip.auth = TRUE;
+}
+
+static void setEigrpAuth(struct config_options *co, int arg)
+{
+  co->eigrp.auth = TRUE;
+}
+
+static void setRsvpAdspec(struct config_options *co, int arg)
+{
+  co->rsvp.type = RSVP_MESSAGE_TYPE_PATH;
+  co->rsvp.adspec = arg;
+}
+
+static void setOspfType(struct config_options *co, int arg)
+{
+  co->ospf.type = arg;
+  co->ospf.dd_include_lsa = TRUE;
+}
+
+static void setOspfLsa(struct config_options *co, int arg)
+{
+  co->ospf.type = OSPF_TYPE_LSUPDATE;
+  co->ospf.lsa_type = arg;
+}
+
+static void setOspfAuth(struct config_options *co, int arg)
+{
+  co->ospf.auth = TRUE;
+}
+
+static const bench_variant_t variants[] = {
+  { NULL,    "default",            setNothing,    0 },
+  { NULL,    "gre",                setGre,        0 },
+  { NULL,    "gre-seq-key-cksum",  setGre,        GRE_OPTION_SEQUENCE | GRE_OPTION_KEY | GRE_OPTION_CHECKSUM },
+  { "TCP",   "tcp-options",        setTcpOptions, 0 },
+  { "TCP",   "tcp-md5",            setTcpAuth,    TRUE },
+  { "TCP",   "tcp-ao",             setTcpAuth,    FALSE },
+  { "RIPv2", "rip-auth",           setRipAuth,    0 },
+  { "EIGRP", "eigrp-auth",         setEigrpAuth,  0 },
+  { "RSVP",  "adspec-guaranteed",  setRsvpAdspec, ADSPEC_GUARANTEED_SERVICE },
+  { "RSVP",  "adspec-controlled",  setRsvpAdspec, ADSPEC_CONTROLLED_SERVICE },
+  { "OSPF",  "dd-lsa",             setOspfType,   OSPF_TYPE_DD },
+  { "OSPF",  "lsrequest",          setOspfType,   OSPF_TYPE_LSREQUEST },
+  { "OSPF",  "lsack",              setOspfType,   OSPF_TYPE_LSACK },
+  { "OSPF",  "lsu-router",         setOspfLsa,    LSA_TYPE_ROUTER },
+  { "OSPF",  "lsu-network",        setOspfLsa,    LSA_TYPE_NETWORK },
+  { "OSPF",  "lsu-summary-ip",     setOspfLsa,    LSA_TYPE_SUMMARY_IP },
+  { "OSPF",  "lsu-summary-as",     setOspfLsa,    LSA_TYPE_SUMMARY_AS },
+  { "OSPF",  "lsu-asbr",           setOspfLsa,    LSA_TYPE_ASBR },
+  { "OSPF",  "lsu-multicast",      setOspfLsa,    LSA_TYPE_MULTICAST },
+  { "OSPF",  "lsu-nssa",           setOspfLsa,    LSA_TYPE_NSSA },
+  { "OSPF",  "ospf-auth",          setOspfAuth,   0 },
+  { NULL,    NULL,                 NULL,          0 }
+};
+
+typedef struct {
+  double   ns;                    /* per packet */
+  double   cycles;
+} bench_result_t;
+
+static uint64_t readCycles(void)
+{
+#ifdef HAVE_TSC
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+/* Best of BENCH_ROUNDS rounds of BENCH_PACKETS packets. */
+static void timeBuilder(modules_table_t *ptbl, struct config_options *co, int use_template,
+                        size_t *size, bench_result_t *r)
+{
+  uint64_t t0, t1, c0, c1, best_ns, best_cycles;
+  unsigned round, i;
+
+  best_ns = best_cycles = UINT64_MAX;
+
+  for (round = 0; round < BENCH_ROUNDS; round++)
+  {
+    t0 = pacingClock();
+    c0 = readCycles();
+
+    if (use_template)
+      for (i = 0; i < BENCH_PACKETS; i++)
+        buildPacket(ptbl, co, size);
+    else
+      for (i = 0; i < BENCH_PACKETS; i++)
+        ptbl->func(co, size);
+
+    c1 = readCycles();
+    t1 = pacingClock();
+
+    /* Keeps the compiler from optimizing the packets away. */
+    __asm__ __volatile__("" : : "r"(packet) : "memory");
+
+    if (t1 - t0 < best_ns)
+      best_ns = t1 - t0;
+    if (c1 - c0 < best_cycles)
+      best_cycles = c1 - c0;
+  }
+
+  r->ns = (double)best_ns / BENCH_PACKETS;
+  r->cycles = (double)best_cycles / BENCH_PACKETS;
+}
+
+static void printResult(const bench_result_t *r)
+{
+  printf("  %8.1f  %8.3f", r->ns, 1e3 / r->ns);
+
+#ifdef HAVE_TSC
+  printf("  %8.1f", r->cycles);
+#else
+  printf("  %8s", "-");
+#endif
+}
+
+static void benchVariant(modules_table_t *ptbl, const struct config_options * const __restrict__ co,
+                         const bench_variant_t *v)
+{
+  struct config_options tmp;
+  bench_result_t r;
+  size_t size;
+
+  /* NOTE: Modules get a copy, since their options are changed here. */
+  tmp = *co;
+  v->set(&tmp, v->arg);
+  tmp.ip.protocol = ptbl->protocol_id;
+  tmp.ip.protoname = ptbl - mod_table;
+
+  timeBuilder(ptbl, &tmp, FALSE, &size, &r);
+  printf("%-8s %-20s %6zu", ptbl->acronym, v->name, size);
+  printResult(&r);
+
+  /* Templates depend on the options, so they're compiled again. */
+  compileTemplates(&tmp);
+  if (hasTemplate(ptbl))
+  {
+    timeBuilder(ptbl, &tmp, TRUE, &size, &r);
+    printResult(&r);
+  }
+
+  putchar('\n');
+  fflush(stdout);
+}
+
+int runBenchmark(const struct config_options * const __restrict__ co)
+{
+  const bench_variant_t *v;
+  modules_table_t *ptbl;
+
+  assert(co != NULL);
+
+  alloc_packet(INITIAL_PACKET_SIZE);
+
+  printf("%-8s %-20s %6s  %28s  %28s\n", "", "", "", "--------- module ---------", "-------- template --------");
+  printf("%-8s %-20s %6s", "module", "variant", "bytes");
+  printf("  %8s  %8s  %8s", "ns/pkt", "Mpps", "cycles");
+  printf("  %8s  %8s  %8s\n", "ns/pkt", "Mpps", "cycles");
+
+  for (ptbl = mod_table; ptbl->func != NULL; ptbl++)
+  {
+    if (co->ip.protocol != IPPROTO_T50 && ptbl - mod_table != (int)co->ip.protoname)
+      continue;
+
+    for (v = variants; v->name != NULL; v++)
+      if (v->module == NULL || !strcmp(v->module, ptbl->acronym))
+        benchVariant(ptbl, co, v);
+  }
+
+  freeTemplates();
+  return TRUE;
+}
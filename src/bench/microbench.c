@@ -0,0 +1,354 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <common.h>
+
+/* NOTE: Microbenchmarks (release/t50-bench, run by "make bench").
+
+   Times cksum() over several sizes, every module (called directly and through
+   buildPacket(), which uses the templates), config_cidr() plus the choice of
+   the destination address (as the workers do, in each --dest-order) and
+   every random number generator. Results are printed as JSON (default) or
+   CSV, one record per benchmark, so runs of different builds can be compared.
+
+   Every checksum kernel is checked against the RFC 1071 one first (see
+   checkCksum()): On a mismatch nothing is timed and the exit status is 1.
+   With --check ("make check") only the kernels are checked.
+
+   Usage: t50-bench [--json | --csv | --check] [t50 options] [target]
+
+   The t50 options (default: --protocol T50 127.0.0.1/16) configure the modules. */
+
+#define ROUND_NS     1000000      /* each round takes at least 1 ms */
+#define ROUNDS       20           /* the best one is reported       */
+
+typedef void (*bench_func_t)(void *, unsigned);
+
+typedef struct {
+  const char *group;
+  const char *name;
+  size_t      size;               /* bytes per operation (0: none) */
+  double      ns;                 /* per operation                 */
+} result_t;
+
+static int csv = FALSE;
+static int check = FALSE;
+static unsigned num_results = 0;
+
+/* Times 'func' doing 'n' operations per call. 'n' is calibrated first, so
+   a round takes about ROUND_NS. Returns the best ns per operation. */
+static double timeIt(bench_func_t func, void *arg)
+{
+  uint64_t t0, t, best;
+  unsigned n, round;
+
+  for (n = 16;; n *= 2)
+  {
+    t0 = pacingClock();
+    func(arg, n);
+    if ((t = pacingClock() - t0) >= ROUND_NS / 4 || n >= (1U << 30))
+      break;
+  }
+  n = (uint64_t)n * ROUND_NS / (t ? t : 1) + 1;
+
+  best = UINT64_MAX;
+  for (round = 0; round < ROUNDS; round++)
+  {
+    t0 = pacingClock();
+    func(arg, n);
+    if ((t = pacingClock() - t0) < best)
+      best = t;
+  }
+
+  return (double)best / n;
+}
+
+static void report(const char *group, const char *name, size_t size, double ns)
+{
+  double gbits;
+
+  gbits = size ? size * 8 / ns : 0;
+
+  if (csv)
+  {
+    if (num_results == 0)
+      puts("group,name,bytes,ns_per_op,mops,gbit_s");
+    printf("%s,%s,%zu,%.3f,%.3f,%.3f\n", group, name, size, ns, 1e3 / ns, gbits);
+  }
+  else
+    printf("%s\n    { \"group\": \"%s\", \"name\": \"%s\", \"bytes\": %zu, "
+           "\"ns_per_op\": %.3f, \"mops\": %.3f, \"gbit_s\": %.3f }",
+           num_results ? "," : "", group, name, size, ns, 1e3 / ns, gbits);
+
+  num_results++;
+  fflush(stdout);
+}
+
+/* XXX cksum() */
+typedef struct {
+  void   *data;
+  size_t  size;
+} cksum_arg_t;
+
+static void benchCksum(void *arg, unsigned n)
+{
+  cksum_arg_t *a = arg;
+  uint16_t sum = 0;
+
+  while (n--)
+    sum += cksum(a->data, a->size);
+
+  __asm__ __volatile__("" : : "r"(sum));
+}
+
+static void cksumBenchmarks(void)
+{
+  static const size_t sizes[] = { 8, 16, 20, 40, 64, 128, 256, 576, 1500, 4096, 9000, 65535 };
+  cksum_arg_t a;
+  unsigned i, j;
+  uint8_t *buffer;
+
+  if ((buffer = malloc(65536 + 64)) == NULL)
+    return;
+  for (j = 0; j < 65536 + 64; j++)
+    buffer[j] = __RANDOM();
+
+  for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+  {
+    a.size = sizes[i];
+
+    a.data = buffer;
+    report("cksum", "aligned", a.size, timeIt(benchCksum, &a));
+
+    a.data = buffer + 1;
+    report("cksum", "unaligned", a.size, timeIt(benchCksum, &a));
+  }
+
+  free(buffer);
+}
+
+/* XXX Modules */
+typedef struct {
+  modules_table_t       *ptbl;
+  struct config_options *co;
+  size_t                 size;
+} module_arg_t;
+
+static void benchModule(void *arg, unsigned n)
+{
+  module_arg_t *a = arg;
+
+  while (n--)
+    a->ptbl->func(a->co, &a->size);
+
+  __asm__ __volatile__("" : : "r"(packet) : "memory");
+}
+
+static void benchBuildPacket(void *arg, unsigned n)
+{
+  module_arg_t *a = arg;
+
+  while (n--)
+    buildPacket(a->ptbl, a->co, &a->size);
+
+  __asm__ __volatile__("" : : "r"(packet) : "memory");
+}
+
+static void moduleBenchmarks(const struct config_options * const __restrict__ co)
+{
+  struct config_options tmp;
+  module_arg_t a;
+  modules_table_t *ptbl;
+  double ns;
+
+  tmp = *co;
+  a.co = &tmp;
+
+  for (ptbl = mod_table; ptbl->func != NULL; ptbl++)
+  {
+    if (co->ip.protocol != IPPROTO_T50 && ptbl - mod_table != (int)co->ip.protoname)
+      continue;
+
+    a.ptbl = ptbl;
+    tmp.ip.protocol = ptbl->protocol_id;
+    tmp.ip.protoname = ptbl - mod_table;
+
+    ns = timeIt(benchModule, &a);
+    report("module", ptbl->acronym, a.size, ns);
+
+    ns = timeIt(benchBuildPacket, &a);
+    report(hasTemplate(ptbl) ? "template" : "buildPacket", ptbl->acronym, a.size, ns);
+  }
+}
+
+/* XXX CIDR and destination addresses */
+typedef struct {
+  uint32_t  bits;
+  in_addr_t addr;
+  const struct cidr *cidr;
+  dest_iter_t dest;
+} cidr_arg_t;
+
+static void benchConfigCidr(void *arg, unsigned n)
+{
+  cidr_arg_t *a = arg;
+  uint32_t bits = a->bits;
+  in_addr_t addr = a->addr;
+
+  /* The arguments are hidden from the optimizer, or the calls would be hoisted. */
+  while (n--)
+  {
+    __asm__ __volatile__("" : "+r"(bits), "+r"(addr));
+    a->cidr = config_cidr(bits, addr);
+  }
+
+  __asm__ __volatile__("" : : "r"(a->cidr) : "memory");
+}
+
+/* Same as the workers. */
+static void benchDaddr(void *arg, unsigned n)
+{
+  cidr_arg_t *a = arg;
+  in_addr_t sum = 0;
+
+  while (n--)
+    sum += nextDestination(&a->dest);
+
+  __asm__ __volatile__("" : : "r"(sum));
+}
+
+static void cidrBenchmarks(const struct config_options * const __restrict__ co)
+{
+  static const uint32_t bits[] = { 8, 16, 24, 30, 32 };
+  static const char *orders[] = { "random", "sequential", "permutation" };
+  cidr_arg_t a;
+  char name[48];
+  unsigned i, order;
+
+  a.addr = co->ip.daddr;
+
+  for (i = 0; i < sizeof(bits) / sizeof(bits[0]); i++)
+  {
+    a.bits = bits[i];
+
+    snprintf(name, sizeof(name), "config_cidr/%u", a.bits);
+    report("cidr", name, 0, timeIt(benchConfigCidr, &a));
+
+    if ((a.cidr = config_cidr(a.bits, a.addr)) == NULL)
+      continue;
+
+    for (order = DEST_RANDOM; order <= DEST_PERMUTATION; order++)
+    {
+      initDestinations(&a.dest, a.cidr, order, SHARD_STRIDED, 0, 1);
+      snprintf(name, sizeof(name), "daddr/%s/%u", orders[order], a.bits);
+      report("cidr", name, 0, timeIt(benchDaddr, &a));
+    }
+  }
+}
+
+/* XXX Random number generators */
+static void benchRandom(void *arg, unsigned n)
+{
+  uint32_t sum = 0;
+
+  while (n--)
+    sum += __RANDOM();
+
+  __asm__ __volatile__("" : : "r"(sum));
+}
+
+static void rngBenchmarks(const struct config_options * const __restrict__ co)
+{
+  struct config_options tmp;
+  rng_table_t *ptbl;
+
+  tmp = *co;
+
+  for (ptbl = rng_table; ptbl->fill != NULL; ptbl++)
+  {
+    if (ptbl->available != NULL && !ptbl->available())
+      continue;
+
+    /* The ring is emptied, so the next word comes from the new generator. */
+    tmp.rng = ptbl - rng_table;
+    initRandom(&tmp);
+    random_next = RANDOM_RING_SIZE;
+
+    report("rng", ptbl->name, 4, timeIt(benchRandom, NULL));
+  }
+
+  initRandom(co);
+  random_next = RANDOM_RING_SIZE;
+}
+
+int main(int argc, char *argv[])
+{
+  static char *defaults[] = { "--protocol", "T50", "127.0.0.1/16" };
+  struct config_options *co;
+  char **args;
+  int n, i;
+
+  if (argc > 1 && (!strcmp(argv[1], "--csv") || !strcmp(argv[1], "--json") || !strcmp(argv[1], "--check")))
+  {
+    csv = !strcmp(argv[1], "--csv");
+    check = !strcmp(argv[1], "--check");
+    argv++;
+    argc--;
+  }
+
+  /* NOTE: getConfigOptions() needs the program name and a target. */
+  if ((args = calloc(argc + 4, sizeof(char *))) == NULL)
+    return EXIT_FAILURE;
+
+  args[0] = argv[0];
+  n = 1;
+  if (argc == 1)
+    for (i = 0; i < 3; i++)
+      args[n++] = defaults[i];
+  else
+    for (i = 1; i < argc; i++)
+      args[n++] = argv[i];
+
+  if ((co = getConfigOptions(n, args)) == NULL || !checkConfigOptions(co))
+    return EXIT_FAILURE;
+
+  initRandom(co);
+  if (!checkCksum())
+    return EXIT_FAILURE;
+  if (check)
+    return EXIT_SUCCESS;
+
+  if (!loadPayload(co))
+    return EXIT_FAILURE;
+  compileTemplates(co);
+  alloc_packet(INITIAL_PACKET_SIZE);
+
+  if (!csv)
+    printf("{\n  \"version\": \"%s\",\n  \"results\": [", VERSION);
+
+  cksumBenchmarks();
+  moduleBenchmarks(co);
+  cidrBenchmarks(co);
+  rngBenchmarks(co);
+
+  if (!csv)
+    puts("\n  ]\n}");
+
+  return EXIT_SUCCESS;
+}
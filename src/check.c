@@ -21,40 +21,120 @@
 
 /* Evaluate the threshold configuration */
 static int checkThreshold(const struct config_options * const __restrict__);
+static int checkStream(const struct config_options * const __restrict__);
 
 /* Validate options 
    NOTE: This function must be called before forking!
    Returns 0 on failure. */
 int checkConfigOptions(const struct config_options * const __restrict__ co)
 {
+  unsigned i;
+  int t50;
+
   assert(co != NULL);
 
-  /* Warns about missed target. */
-  if (co->ip.daddr == INADDR_ANY)
+  if (num_streams == 0 && !checkStream(co))
+    return FALSE;
+
+  for (i = 0; i < num_streams; i++)
+    if (!checkStream(&streams[i].co))
+    {
+      fprintf(stderr, "%s: on stream '%s'\n", PACKAGE, streams[i].args);
+      return FALSE;
+    }
+
+  /* Sanitizing the batch size. */
+  if (co->batch < 1 || co->batch > MAXIMUM_BATCH)
   {
-    ERROR("Need target address. Try --help for usage");
+    fprintf(stderr,
+            "%s: batch size must be between 1 and %d\n",
+            PACKAGE,
+            MAXIMUM_BATCH);
     return FALSE;
   }
 
-  /* FIX: Deleted 'bits' validation code. Code already in getIpAndCidrFromString() at config.c. */
+  /* Sanitizing the number of threads. */
+  if (co->threads < 1 || co->threads > MAXIMUM_THREADS)
+  {
+    fprintf(stderr,
+            "%s: number of threads must be between 1 and %d\n",
+            PACKAGE,
+            MAXIMUM_THREADS);
+    return FALSE;
+  }
 
-  /* Sanitizing the TCP Options SACK_Permitted and SACK Edges. */
-  if (TEST_BITS(co->tcp.options, TCP_OPTION_SACK_OK) &&
-      TEST_BITS(co->tcp.options, TCP_OPTION_SACK_EDGE))
+  /* Sanitizing the packet pool. */
+  if (co->pool > MAXIMUM_POOL)
   {
-    ERROR("TCP options SACK-Permitted and SACK Edges are not allowed");
+    fprintf(stderr,
+            "%s: pool size must be between 0 and %d\n",
+            PACKAGE,
+            MAXIMUM_POOL);
     return FALSE;
   }
 
-  /* Sanitizing the TCP Options T/TCP CC and T/TCP CC.ECHO. */
-  if (TEST_BITS(co->tcp.options, TCP_OPTION_CC) && (co->tcp.cc_echo))
+  /* Sanitizing the statistics interval. */
+  if (co->stats < 0)
   {
-    ERROR("TCP options T/TCP CC and T/TCP CC.ECHO are not allowed");
+    fprintf(stderr, "%s: statistics interval cannot be negative\n", PACKAGE);
     return FALSE;
   }
 
-  if (!checkThreshold(co))
+  /* File backends need a file. */
+  if ((backend_table[co->backend].flags & BACKEND_FILE) && co->output == NULL)
+  {
+    fprintf(stderr,
+            "%s: backend '%s' needs an output file (--output)\n",
+            PACKAGE,
+            backend_table[co->backend].name);
+    return FALSE;
+  }
+
+  /* Replayed packets go at their times, at the rates or as fast as possible. */
+  if (co->replay_speed < 0 || (co->replay_speed && (co->replay == NULL || co->rate || co->bitrate)))
+  {
+    fprintf(stderr, "%s: --replay-speed must be positive, with --replay and without --rate or --bitrate\n", PACKAGE);
     return FALSE;
+  }
+
+  /* --protocol-mix weighs the modules of T50 packets (with streams, of the T50 streams). */
+  for (i = 0, t50 = co->ip.protocol == IPPROTO_T50; i < num_streams; i++)
+    t50 |= streams[i].co.ip.protocol == IPPROTO_T50;
+
+  if (co->protocol_mix != NULL && !t50)
+  {
+    fprintf(stderr, "%s: --protocol-mix needs --protocol T50\n", PACKAGE);
+    return FALSE;
+  }
+
+  /* Streams build their packets as they go. */
+  if (num_streams && (co->pool || co->replay != NULL || co->bench))
+  {
+    fprintf(stderr, "%s: --stream can't be used with --pool, --replay or --bench\n", PACKAGE);
+    return FALSE;
+  }
+
+  if (co->replay != NULL && co->pool)
+  {
+    fprintf(stderr, "%s: --replay and --pool can't be used together\n", PACKAGE);
+    return FALSE;
+  }
+
+  if (co->replay != NULL && (backend_table[co->backend].flags & BACKEND_UDP))
+  {
+    fprintf(stderr, "%s: backend '%s' can't replay packets\n", PACKAGE, backend_table[co->backend].name);
+    return FALSE;
+  }
+
+  /* Generators depending on the CPU. */
+  if (rng_table[co->rng].available != NULL && !rng_table[co->rng].available())
+  {
+    fprintf(stderr,
+            "%s: random number generator '%s' isn't supported by this CPU\n",
+            PACKAGE,
+            rng_table[co->rng].name);
+    return FALSE;
+  }
 
   if (!co->flood)
   {
@@ -88,6 +168,97 @@ int checkConfigOptions(const struct config_options * const __restrict__ co)
   return TRUE;
 }
 
+/* Validates the options each stream has (the command line ones, without streams). */
+static int checkStream(const struct config_options * const __restrict__ co)
+{
+  /* Warns about missed target. */
+  if (co->ip.daddr == INADDR_ANY && co->replay == NULL && co->targets == NULL)
+  {
+    ERROR("Need target address. Try --help for usage");
+    return FALSE;
+  }
+
+  /* FIX: Deleted 'bits' validation code. Code already in getIpAndCidrFromString() at config.c. */
+
+  /* Sanitizing the TCP Options SACK_Permitted and SACK Edges. */
+  if (TEST_BITS(co->tcp.options, TCP_OPTION_SACK_OK) &&
+      TEST_BITS(co->tcp.options, TCP_OPTION_SACK_EDGE))
+  {
+    ERROR("TCP options SACK-Permitted and SACK Edges are not allowed");
+    return FALSE;
+  }
+
+  /* Sanitizing the TCP Options T/TCP CC and T/TCP CC.ECHO. */
+  if (TEST_BITS(co->tcp.options, TCP_OPTION_CC) && (co->tcp.cc_echo))
+  {
+    ERROR("TCP options T/TCP CC and T/TCP CC.ECHO are not allowed");
+    return FALSE;
+  }
+
+  if (!checkThreshold(co))
+    return FALSE;
+
+  if (co->no_template && co->force_template)
+  {
+    fprintf(stderr, "%s: --no-template and --force-template can't be used together\n", PACKAGE);
+    return FALSE;
+  }
+
+  /* Sanitizing the rate control burst. */
+  if (co->burst > MAXIMUM_BURST)
+  {
+    fprintf(stderr,
+            "%s: burst cannot be bigger than %d\n",
+            PACKAGE,
+            MAXIMUM_BURST);
+    return FALSE;
+  }
+
+  /* Sanitizing the payload size. */
+  if (co->payload_size > MAXIMUM_PAYLOAD)
+  {
+    fprintf(stderr,
+            "%s: payload size must be between 0 and %d\n",
+            PACKAGE,
+            MAXIMUM_PAYLOAD);
+    return FALSE;
+  }
+
+  /* --sizes sets the payload size of each packet. */
+  if (co->sizes != NULL && co->payload_size)
+  {
+    fprintf(stderr, "%s: --sizes and --payload-size can't be used together\n", PACKAGE);
+    return FALSE;
+  }
+
+  /* Transmit times come from the rate control and only the raw backend sends them. */
+  if (co->txtime && ((co->rate == 0 && co->bitrate == 0 && co->replay_speed == 0) ||
+                     strcmp(backend_table[co->backend].name, "raw")))
+  {
+    fprintf(stderr, "%s: --txtime needs --rate, --bitrate or --replay-speed and the raw backend\n", PACKAGE);
+    return FALSE;
+  }
+
+  if (co->targets != NULL && (co->ip.daddr != INADDR_ANY || co->dest_order != DEST_RANDOM))
+  {
+    fprintf(stderr, "%s: --targets can't be used with a target or --dest-order\n", PACKAGE);
+    return FALSE;
+  }
+
+  /* Backends sending UDP payloads only. */
+  if ((backend_table[co->backend].flags & BACKEND_UDP) &&
+      (co->ip.protocol != IPPROTO_UDP || co->encapsulated))
+  {
+    fprintf(stderr,
+            "%s: backend '%s' sends UDP only (--protocol UDP, not encapsulated)\n",
+            PACKAGE,
+            backend_table[co->backend].name);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
 static int checkThreshold(const struct config_options * const __restrict__ co)
 {
   if (co->ip.protocol == IPPROTO_T50)
@@ -19,11 +19,30 @@
 
 #include <common.h>
 
-static struct cidr cidr = { 0, 0 };
+/* NOTE: Destination order (--dest-order).
+
+   Hosts are split in disjoint shards, one per worker (--dest-shards):
+   strided gives worker i the hosts i, i + workers, i + 2 * workers, ... and
+   contiguous a block of hostid / workers hosts. Workers never share state
+   and never send to the same host (unless there are more workers than hosts).
+
+   random picks each host of the shard as before, by multiplying instead of
+   dividing (the high half of RANDOM() * count: no bias worth mentioning below
+   2^24 hosts). sequential and permutation visit every host of the shard once
+   per cycle. permutation is a Feistel network on the perm_bits bits of the
+   shard index (unbalanced when perm_bits is odd, so the domain is less than
+   twice the hosts). Indexes past the shard are skipped, so less than two
+   indexes are tried per address on average. */
+
+static struct cidr cidr = {};
+
+static uint32_t permute(const struct cidr *, uint32_t, uint32_t);
 
 /* CIDR configuration tiny C algorithm */
 struct cidr *config_cidr(uint32_t bits, in_addr_t address)
 {
+  unsigned i;
+
   /* FIX: Don't need to validate bits. It is already done in getIpAndCidrFromString() function @ config.c */
 
   /*
@@ -81,5 +100,156 @@ struct cidr *config_cidr(uint32_t bits, in_addr_t address)
     cidr.__1st_addr = ntohl(address);
   }
 
+  /* A new permutation for each CIDR. */
+  for (i = 0; i < CIDR_PERMUTATION_ROUNDS; i++)
+    cidr.perm_keys[i] = __RANDOM();
+
   return &cidr;
 }
+
+/* Shard of 'worker' (of 'workers'), in 'shards' layout. */
+void initDestinations(dest_iter_t *d, const struct cidr *c, uint32_t order, uint32_t shards,
+                      unsigned worker, unsigned workers)
+{
+  assert(d != NULL);
+  assert(c != NULL);
+  assert(workers > 0);
+
+  d->cidr = c;
+  d->order = order;
+  d->base = d->count = d->perm_bits = d->index = 0;
+  d->stride = 1;
+
+  /* --targets replaces the CIDR. */
+  if (num_targets)
+    d->order = DEST_TARGETS;
+
+  if (c->hostid == 0)
+    return;
+
+  /* Workers without a host of their own share one. */
+  if (workers > c->hostid)
+    workers = c->hostid;
+  worker %= workers;
+
+  /* The first workers get the extra hosts, as they get the extra packets. */
+  if (shards == SHARD_CONTIGUOUS)
+  {
+    d->count = c->hostid / workers + (worker < c->hostid % workers);
+    d->base = worker * (c->hostid / workers) + (worker < c->hostid % workers ? worker : c->hostid % workers);
+  }
+  else
+  {
+    d->base = worker;
+    d->stride = workers;
+    d->count = (c->hostid - worker + workers - 1) / workers;
+  }
+
+  d->perm_bits = d->count > 1 ? 32 - __builtin_clz(d->count - 1) : 0;
+}
+
+in_addr_t nextDestination(dest_iter_t *d)
+{
+  const struct cidr *c = d->cidr;
+  uint32_t k, mask;
+
+  if (d->order == DEST_TARGETS)
+    return drawTarget();
+
+  if (c->hostid == 0)
+    return htonl(c->__1st_addr);
+
+  switch (d->order)
+  {
+    case DEST_SEQUENTIAL:
+      k = d->index;
+      if (++d->index == d->count)
+        d->index = 0;
+      break;
+
+    case DEST_PERMUTATION:
+      mask = (1U << d->perm_bits) - 1;
+      do
+      {
+        k = permute(c, d->perm_bits, d->index);
+        d->index = (d->index + 1) & mask;
+      } while (k >= d->count);
+      break;
+
+    default:
+      k = ((uint64_t)__RANDOM() * d->count) >> 32;
+  }
+
+  return htonl(c->__1st_addr + d->base + k * d->stride);
+}
+
+/* Feistel network: Each round swaps the halves, mixing the (new) right one
+   with a hash of the left one. Halves differ by a bit when 'bits' is odd. */
+static uint32_t permute(const struct cidr *c, uint32_t bits, uint32_t x)
+{
+  unsigned lbits, rbits, t, i;
+  uint32_t l, r, f;
+
+  lbits = bits / 2;
+  rbits = bits - lbits;
+  l = x >> rbits;
+  r = x & ((1U << rbits) - 1);
+
+  for (i = 0; i < CIDR_PERMUTATION_ROUNDS; i++)
+  {
+    /* murmur3 finalizer. */
+    f = r ^ c->perm_keys[i];
+    f ^= f >> 16;
+    f *= 0x85ebca6bU;
+    f ^= f >> 13;
+    f *= 0xc2b2ae35U;
+    f ^= f >> 16;
+
+    t = r;
+    r = (l ^ f) & ((1U << lbits) - 1);
+    l = t;
+
+    t = lbits;
+    lbits = rbits;
+    rbits = t;
+  }
+
+  return (l << rbits) | r;
+}
+
+/* Hosts a run of 'packets' packets, over 'shards' shards, reached (expected, for random). */
+void printCoverage(const struct config_options * const __restrict__ co, uint64_t packets, unsigned shards)
+{
+  static const char *orders[] = { "random", "sequential", "permutation" };
+  double miss, p, covered;
+  uint64_t n;
+
+  assert(co != NULL);
+
+  if (cidr.hostid == 0 || packets == 0)
+    return;
+
+  /* The pool repeats its addresses. */
+  if (pool_count && packets > pool_count)
+    packets = pool_count;
+
+  if (shards == 0 || shards > cidr.hostid)
+    shards = cidr.hostid;
+
+  if (co->dest_order == DEST_RANDOM)
+  {
+    /* (1 - shards/hostid)^(packets/shards), without libm: Each worker draws
+       from its own shard (shards are about the same size, so are shares). */
+    for (miss = 1.0, p = 1.0 - (double)shards / cidr.hostid, n = packets / shards; n; n >>= 1, p *= p)
+      if (n & 1)
+        miss *= p;
+    covered = cidr.hostid * (1.0 - miss);
+  }
+  else
+    covered = packets < cidr.hostid ? packets : cidr.hostid;
+
+  printf("%s: %u destinations, %s order: %.0f%s covered (%.2f%%), %.2f packets each\n",
+         PACKAGE, cidr.hostid, orders[co->dest_order], covered,
+         co->dest_order == DEST_RANDOM ? " expected" : "",
+         covered * 100.0 / cidr.hostid, (double)packets / cidr.hostid);
+}
@@ -19,73 +19,47 @@
 
 #include <common.h>
 
+/* NOTE: Checksum kernels.
+
+   All of them give the same result of the RFC 1071 implementation (cksum_rfc1071()):
+   The sum of 16 bits words, in host order, is the same (one's complement) as the sum
+   of 32 bits words with end around carry (RFC 1071, 2(C)). 32 bits words are summed
+   on 64 bits, without carries, and folded at the end. A lone last byte is summed as
+   the low byte of a word.
+
+   The SIMD kernels sum each half of 32 bits lanes on two 32 bits accumulators, of
+   up to 0xffff per vector. They're summed on 64 bits every MAX_VECTOR_ADDS vectors.
+   The fastest kernel the CPU supports is selected on the first call, and checked
+   against cksum_rfc1071(). Setting up the vectors isn't worth it for most headers,
+   so data shorter than SIMD_THRESHOLD is summed by cksum_scalar64(). */
+
+#define MAX_VECTOR_ADDS 65536
+#define SIMD_THRESHOLD  256
+
+/* checkCksum() lengths: All of them up to CHECK_ALL_LENGTHS, every CHECK_LENGTH_STEP
+   bytes (and 65535) after that. */
+#define CHECK_ALL_LENGTHS 2048
+#define CHECK_LENGTH_STEP 61
+
+static uint16_t cksum_select(const void *, size_t);
+static uint16_t cksum_scalar64(const void *, size_t);
+
+static uint16_t (*cksum_kernel)(const void *, size_t) = cksum_select;
+
 /* Calculates checksum */
-/* This function is 5 times faster than the "official" rfc 1071 implementation (and shortter too!). */
-
-/* FIXME: Maybe there is a bug here still... Must check. */
-/* NOTE: This version of cksum is retired, for now, due to bugs. */
-//uint16_t cksum(void *data, size_t length)
-//{
-//  uint64_t sum, oldsum, *p = data;
-//  uint32_t t1, t2;
-//  uint16_t t3, t4;
-//
-//  sum = oldsum = 0;
-//
-//  /* Sums 8 bytes at a time... */
-//  while (length >= sizeof(uint64_t))
-//  {
-//    sum += *p++;
-//    if (sum < oldsum) sum++;
-//    oldsum = sum;
-//    length -= sizeof(uint64_t);
-//  }
-//
-//  /* Sums the remaing data, if any */
-//  data = p;
-//  if (length >= sizeof(uint32_t))
-//  {
-//    sum += *(uint32_t *)data;
-//    if (sum < oldsum) sum++;
-//    oldsum = sum;
-//    length -= sizeof(uint32_t);
-//    data += sizeof(uint32_t);
-//  }
-//
-//  if (length >= sizeof(uint16_t))
-//  {
-//    sum += *(uint16_t *)data;
-//    if (sum < oldsum) sum++;
-//    oldsum = sum;
-//    length -= sizeof(uint16_t);
-//    data += sizeof(uint16_t);
-//  }
-//
-//  if (length)
-//  {
-//    sum += *(uint8_t *)data;
-//    if (sum < oldsum) sum++;
-//  }
-//
-//  /* Fold down to 16 bits */
-//  t1 = sum;
-//  t2 = sum >> 32;
-//  t1 += t2;
-//  if (t1 < t2) t1++;
-//
-//  t3 = t1;
-//  t4 = t1 >> 16;
-//  t3 += t4;
-//  if (t3 < t4) t3++;
-//
-//  return ~t3;
-//}
+uint16_t cksum(void *data, size_t length)
+{
+  if (length < SIMD_THRESHOLD)
+    return cksum_scalar64(data, length);
+
+  return cksum_kernel(data, length);
+}
 
 /* This is the old version, implemented on RFC 1071. */
-uint16_t cksum(void *data, size_t length)
+static uint16_t cksum_rfc1071(const void *data, size_t length)
 {
   uint32_t sum;
-  uint16_t *p = data;
+  const uint16_t *p = data;
 
   sum = 0;
 
@@ -103,3 +77,328 @@ uint16_t cksum(void *data, size_t length)
 
   return ~sum;
 }
+
+/* Sums 'data' to 'sum', 8 bytes at a time. Used by all kernels, for the
+   bytes left by the SIMD ones. */
+static inline uint64_t sum64(const uint8_t *p, size_t length, uint64_t sum)
+{
+  uint64_t w64;
+  uint32_t w32;
+  uint16_t w16;
+
+  while (length >= sizeof(uint64_t))
+  {
+    memcpy(&w64, p, sizeof(uint64_t));
+    sum += (w64 & 0xffffffff) + (w64 >> 32);
+    p += sizeof(uint64_t);
+    length -= sizeof(uint64_t);
+  }
+
+  if (length >= sizeof(uint32_t))
+  {
+    memcpy(&w32, p, sizeof(uint32_t));
+    sum += w32;
+    p += sizeof(uint32_t);
+    length -= sizeof(uint32_t);
+  }
+
+  if (length >= sizeof(uint16_t))
+  {
+    memcpy(&w16, p, sizeof(uint16_t));
+    sum += w16;
+    p += sizeof(uint16_t);
+    length -= sizeof(uint16_t);
+  }
+
+  if (length)
+    sum += *p;
+
+  return sum;
+}
+
+/* Folds a 64 bits sum to 16 bits and complements it. */
+static inline uint16_t fold64(uint64_t sum)
+{
+  sum = (sum & 0xffffffff) + (sum >> 32);
+  sum = (sum & 0xffffffff) + (sum >> 32);
+
+  while (sum >> 16)
+    sum = (sum & 0xffff) + (sum >> 16);
+
+  return ~sum;
+}
+
+static uint16_t cksum_scalar64(const void *data, size_t length)
+{
+  return fold64(sum64(data, length, 0));
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+/* NOTE: The accumulators ('lo' and 'hi' halves of the 32 bits lanes) are independent,
+         so both adds of each vector can run at the same time. */
+
+__attribute__((target("sse2")))
+static uint16_t cksum_sse2(const void *data, size_t length)
+{
+  const uint8_t *p = data;
+  const __m128i mask = _mm_set1_epi32(0xffff);
+  __m128i lo, hi, v;
+  uint64_t sum = 0, lanes[2];
+  size_t n;
+
+  while (length >= sizeof(__m128i))
+  {
+    n = length / sizeof(__m128i);
+    if (n > MAX_VECTOR_ADDS)
+      n = MAX_VECTOR_ADDS;
+    length -= n * sizeof(__m128i);
+
+    lo = hi = _mm_setzero_si128();
+    while (n--)
+    {
+      v = _mm_loadu_si128((const __m128i *)p);
+      lo = _mm_add_epi32(lo, _mm_and_si128(v, mask));
+      hi = _mm_add_epi32(hi, _mm_srli_epi32(v, 16));
+      p += sizeof(__m128i);
+    }
+
+    /* Up to 0xffff * MAX_VECTOR_ADDS per lane: lo + hi fit on 64 bits lanes. */
+    v = _mm_set1_epi64x(0xffffffff);
+    lo = _mm_add_epi64(_mm_and_si128(lo, v), _mm_srli_epi64(lo, 32));
+    hi = _mm_add_epi64(_mm_and_si128(hi, v), _mm_srli_epi64(hi, 32));
+    _mm_storeu_si128((__m128i *)lanes, _mm_add_epi64(lo, hi));
+    sum += lanes[0] + lanes[1];
+  }
+
+  return fold64(sum64(p, length, sum));
+}
+
+__attribute__((target("avx2")))
+static uint16_t cksum_avx2(const void *data, size_t length)
+{
+  const uint8_t *p = data;
+  const __m256i mask = _mm256_set1_epi32(0xffff);
+  __m256i lo, hi, v;
+  uint64_t sum = 0, lanes[4];
+  size_t n;
+
+  while (length >= sizeof(__m256i))
+  {
+    n = length / sizeof(__m256i);
+    if (n > MAX_VECTOR_ADDS)
+      n = MAX_VECTOR_ADDS;
+    length -= n * sizeof(__m256i);
+
+    lo = hi = _mm256_setzero_si256();
+    while (n--)
+    {
+      v = _mm256_loadu_si256((const __m256i *)p);
+      lo = _mm256_add_epi32(lo, _mm256_and_si256(v, mask));
+      hi = _mm256_add_epi32(hi, _mm256_srli_epi32(v, 16));
+      p += sizeof(__m256i);
+    }
+
+    v = _mm256_set1_epi64x(0xffffffff);
+    lo = _mm256_add_epi64(_mm256_and_si256(lo, v), _mm256_srli_epi64(lo, 32));
+    hi = _mm256_add_epi64(_mm256_and_si256(hi, v), _mm256_srli_epi64(hi, 32));
+    _mm256_storeu_si256((__m256i *)lanes, _mm256_add_epi64(lo, hi));
+    sum += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  }
+
+  return fold64(sum64(p, length, sum));
+}
+
+__attribute__((target("avx512f")))
+static uint16_t cksum_avx512(const void *data, size_t length)
+{
+  const uint8_t *p = data;
+  const __m512i mask = _mm512_set1_epi32(0xffff);
+  __m512i lo, hi, v;
+  uint64_t sum = 0;
+  size_t n;
+
+  while (length >= sizeof(__m512i))
+  {
+    n = length / sizeof(__m512i);
+    if (n > MAX_VECTOR_ADDS)
+      n = MAX_VECTOR_ADDS;
+    length -= n * sizeof(__m512i);
+
+    lo = hi = _mm512_setzero_si512();
+    while (n--)
+    {
+      v = _mm512_loadu_si512((const void *)p);
+      lo = _mm512_add_epi32(lo, _mm512_and_si512(v, mask));
+      hi = _mm512_add_epi32(hi, _mm512_srli_epi32(v, 16));
+      p += sizeof(__m512i);
+    }
+
+    v = _mm512_set1_epi64(0xffffffff);
+    lo = _mm512_add_epi64(_mm512_and_si512(lo, v), _mm512_srli_epi64(lo, 32));
+    hi = _mm512_add_epi64(_mm512_and_si512(hi, v), _mm512_srli_epi64(hi, 32));
+    sum += _mm512_reduce_add_epi64(_mm512_add_epi64(lo, hi));
+  }
+
+  return fold64(sum64(p, length, sum));
+}
+#endif
+
+typedef struct {
+  const char *name;
+  uint16_t  (*func)(const void *, size_t);
+} cksum_kernel_t;
+
+/* Fills 'k' with the kernels the CPU supports, fastest first. Returns how many. */
+static unsigned supportedKernels(cksum_kernel_t *k)
+{
+  unsigned n = 0;
+
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("avx512f"))
+    k[n++] = (cksum_kernel_t){ "avx512", cksum_avx512 };
+  if (__builtin_cpu_supports("avx2"))
+    k[n++] = (cksum_kernel_t){ "avx2", cksum_avx2 };
+  if (__builtin_cpu_supports("sse2"))
+    k[n++] = (cksum_kernel_t){ "sse2", cksum_sse2 };
+#endif
+
+  k[n++] = (cksum_kernel_t){ "scalar64", cksum_scalar64 };
+
+  return n;
+}
+
+/* Selects the kernel on the first call. */
+static uint16_t cksum_select(const void *data, size_t length)
+{
+  cksum_kernel_t k[4];
+  uint8_t test[256];
+  size_t i, j;
+
+  supportedKernels(k);
+
+  /* Every length and alignment up to a few vectors. */
+  for (i = 0; i < sizeof(test); i++)
+    test[i] = i * 167 + 13;
+
+  for (i = 0; i < 64 && k->func != cksum_rfc1071; i++)
+    for (j = 0; i + j <= sizeof(test); j++)
+      if (k->func(test + i, j) != cksum_rfc1071(test + i, j))
+      {
+        fprintf(stderr, "%s: %s checksum wrong on %zu bytes at offset %zu, using the RFC 1071 one\n",
+                PACKAGE, k->name, j, i);
+        k->func = cksum_rfc1071;
+        break;
+      }
+
+  cksum_kernel = k->func;
+  return cksum_kernel(data, length);
+}
+
+static uint16_t cksum_dispatch(const void *data, size_t length)
+{
+  return cksum((void *)data, length);
+}
+
+static size_t nextLength(size_t length)
+{
+  if (length < CHECK_ALL_LENGTHS)
+    return length + 1;
+  if (length < 65535 - CHECK_LENGTH_STEP)
+    return length + CHECK_LENGTH_STEP;
+
+  return length < 65535 ? 65535 : length + 1;
+}
+
+/* Checks every kernel the CPU supports, and cksum(), against cksum_rfc1071():
+   Every length up to CHECK_ALL_LENGTHS at alignments 0 to 63, then lengths
+   up to 65535 (IP packets) at alignments 0 to 7, on random, all ones and all
+   zeros data. Mismatches are reported to stderr. Returns TRUE if none. */
+int checkCksum(void)
+{
+  static const int fills[] = { -1, 0xff, 0x00 };    /* -1: random */
+  cksum_kernel_t k[5];
+  unsigned n, i, fill, errors = 0;
+  uint64_t checks = 0;
+  size_t offset, length, max_offset;
+  uint8_t *buffer, *p;
+  uint16_t expected;
+
+  n = supportedKernels(k);
+  k[n++] = (cksum_kernel_t){ "cksum", cksum_dispatch };
+
+  if ((buffer = malloc(65535 + 64)) == NULL)
+  {
+    ERROR("Error allocating checksum buffer");
+    return FALSE;
+  }
+
+  for (fill = 0; fill < sizeof(fills) / sizeof(fills[0]); fill++)
+  {
+    for (offset = 0; offset < 65535 + 64; offset++)
+      buffer[offset] = fills[fill] < 0 ? (uint8_t)__RANDOM() : fills[fill];
+
+    for (length = 0; length <= 65535; length = nextLength(length))
+    {
+      max_offset = length <= CHECK_ALL_LENGTHS ? 64 : 8;
+
+      for (offset = 0; offset < max_offset; offset++)
+      {
+        p = buffer + offset;
+        expected = cksum_rfc1071(p, length);
+
+        for (i = 0; i < n; i++, checks++)
+          if (k[i].func(p, length) != expected && errors++ < 10)
+            fprintf(stderr, "%s: %s checksum wrong on %zu bytes at offset %zu (fill %d)\n",
+                    PACKAGE, k[i].name, length, offset, fills[fill]);
+      }
+    }
+  }
+
+  free(buffer);
+
+  fprintf(stderr, "%s: %u checksum kernels, %llu checks, %u wrong\n",
+          PACKAGE, n, (unsigned long long)checks, errors);
+
+  return errors == 0;
+}
+
+/* RFC 1624 [Eqn. 3]: Updates checksum 'hc' when the data sum changes by 'delta'
+   (see cksumDelta()), without summing the data again: HC' = ~(~HC + ~m + m').
+   The result is the same cksum() would give, unless the data is all zeros. */
+uint16_t updateCksum(uint16_t hc, uint32_t delta)
+{
+  uint32_t sum;
+
+  sum = (uint16_t)~hc + delta;
+
+  while (sum >> 16)
+    sum = (sum & 0xffff) + (sum >> 16);
+
+  return ~sum;
+}
+
+/* Sum of ~m + m' for the 16 bits words changed when up to 4 bytes change from 'old'
+   to 'new'. 'odd' tells if the bytes start on an odd offset of the data: Words are
+   summed as if they started on an even one, then swapped (RFC 1071, 2(B)). */
+uint32_t cksumDelta(const void *old, const void *new, size_t length, int odd)
+{
+  uint32_t m = 0, m1 = 0, sum;
+
+  assert(length <= sizeof(uint32_t));
+
+  memcpy(&m, old, length);
+  memcpy(&m1, new, length);
+
+  sum = (uint16_t)~m + (uint16_t)~(m >> 16) + (m1 & 0xffff) + (m1 >> 16);
+  sum = (sum & 0xffff) + (sum >> 16);
+  sum = (sum & 0xffff) + (sum >> 16);
+
+  if (odd)
+    sum = ((sum >> 8) | (sum << 8)) & 0xffff;
+
+  return sum;
+}
@@ -19,9 +19,12 @@
 
 #include <common.h>
 
-/* Actual packet buffer. Allocated dynamically. */
-void *packet = NULL;
-size_t current_packet_size = 0;
+/* Actual packet buffer. Allocated dynamically, one per worker thread. */
+__thread void *packet = NULL;
+__thread size_t current_packet_size = 0;
+
+/* TRUE if 'packet' points to memory owned by the output backend. */
+static __thread int backend_packet = FALSE;
 
 /* "private" variable holding the number of modules. Use getNumberOfRegisteredModules() funcion to get it. */
 static size_t numOfModules = 0;
@@ -53,6 +56,13 @@ void alloc_packet(size_t new_packet_size)
 
   if (new_packet_size > current_packet_size)
   {
+    /* Backend frames cannot grow. */
+    if (backend_packet)
+    {
+      ERROR("Packet is bigger than the backend frame");
+      exit(EXIT_FAILURE);
+    }
+
     if ((p = realloc(packet, new_packet_size)) == NULL)
     {
       ERROR("Error reallocating packet buffer");
@@ -64,6 +74,20 @@ void alloc_packet(size_t new_packet_size)
   }
 }
 
+/* The next packets will be built at 'buffer', which can hold 'size' bytes.
+   NOTE: The backend keeps ownership of the buffer. */
+void set_packet_buffer(void *buffer, size_t size)
+{
+  assert(buffer != NULL);
+
+  if (!backend_packet)
+    free(packet);
+
+  packet = buffer;
+  current_packet_size = size;
+  backend_packet = TRUE;
+}
+
 /* Scan the list of modules (ONCE!), returning the number of itens in the list. */
 /* Function prototype moved to modules.h. */
 /* NOTE: This function is here to not polute modules.c, where we keep only the modules definitions. */
@@ -77,20 +101,3 @@ size_t getNumberOfRegisteredModules(void)
 	return numOfModules;
 }
 
-#ifdef __HAVE_RDRAND__
-uint32_t readrand(void)
-{
-  uint32_t d;
-
-  /* Using assembly here is more reliable than using the intrinsic funcion! */
-  __asm__ __volatile__ (
-    "1:\n"
-    "rdrand %0\n"
-    "jnc 1b\n"         /* Carry flag is zero if RDRAND fails. 
-                          No need to implement a failsafe here. RDRAND will work eventually. */
-    : "=r" (d)
-  );
-
-  return d;
-}
-#endif
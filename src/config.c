@@ -29,6 +29,11 @@
 static struct config_options co = {
   /* XXX COMMON OPTIONS                                                         */
   .threshold = 1000,                  /* default threshold                      */
+  .batch = 1,                         /* default packets per send call          */
+  .threads = 1,                       /* default number of worker threads       */
+#ifdef __HAVE_DEBUG__
+  .force_template = 1,                /* keep templates (-O0 timings are noise) */
+#endif
 
   /* XXX IP HEADER OPTIONS  (IPPROTO_IP = 0)                                    */
   .ip = {
@@ -127,6 +132,37 @@ static const struct option long_opt[] = {
 #ifdef  __HAVE_TURBO__
   { "turbo",                  no_argument,       NULL, OPTION_TURBO                  },
 #endif  /* __HAVE_TURBO__ */
+  { "threads",                required_argument, NULL, OPTION_THREADS                },
+  { "batch",                  required_argument, NULL, OPTION_BATCH                  },
+  { "no-template",            no_argument,       NULL, OPTION_NO_TEMPLATE            },
+  { "force-template",         no_argument,       NULL, OPTION_FORCE_TEMPLATE         },
+  { "pool",                   required_argument, NULL, OPTION_POOL                   },
+  { "rate",                   required_argument, NULL, OPTION_RATE                   },
+  { "bitrate",                required_argument, NULL, OPTION_BITRATE                },
+  { "burst",                  required_argument, NULL, OPTION_BURST                  },
+  { "txtime",                 required_argument, NULL, OPTION_TXTIME                 },
+  { "stats",                  required_argument, NULL, OPTION_STATS                  },
+  { "bench",                  no_argument,       NULL, OPTION_BENCH                  },
+  { "payload-size",           required_argument, NULL, OPTION_PAYLOAD_SIZE           },
+  { "payload-file",           required_argument, NULL, OPTION_PAYLOAD_FILE           },
+  { "sizes",                  required_argument, NULL, OPTION_SIZES                  },
+  { "replay",                 required_argument, NULL, OPTION_REPLAY                 },
+  { "replay-speed",           required_argument, NULL, OPTION_REPLAY_SPEED           },
+  { "rng",                    required_argument, NULL, OPTION_RNG                    },
+  { "dest-order",             required_argument, NULL, OPTION_DEST_ORDER             },
+  { "dest-shards",            required_argument, NULL, OPTION_DEST_SHARDS            },
+  { "targets",                required_argument, NULL, OPTION_TARGETS                },
+  { "protocol-mix",           required_argument, NULL, OPTION_PROTOCOL_MIX           },
+  { "stream",                 required_argument, NULL, OPTION_STREAM                 },
+  { "list-rngs",              no_argument,       NULL, OPTION_LIST_RNG               },
+  { "backend",                required_argument, NULL, OPTION_BACKEND                },
+  { "output",                 required_argument, NULL, OPTION_OUTPUT                 },
+  { "pcap-ether",             no_argument,       NULL, OPTION_PCAP_ETHER             },
+  { "interface",              required_argument, NULL, OPTION_INTERFACE              },
+  { "dst-mac",                required_argument, NULL, OPTION_DST_MAC                },
+  { "qdisc-bypass",           no_argument,       NULL, OPTION_QDISC_BYPASS           },
+  { "queue",                  required_argument, NULL, OPTION_QUEUE                  },
+  { "list-backends",          no_argument,       NULL, OPTION_LIST_BACKEND           },
   { "version",                no_argument,       NULL, 'v'                           },
   { "help",                   no_argument,       NULL, 'h'                           },
 
@@ -385,27 +421,70 @@ typedef struct {
 
 static char **getTokensList(void);
 static void listProtocols(void);
+static void listBackends(void);
+static int  getBackendIndex(char const * const);
+static void listRngs(void);
+static int  getRngIndex(char const * const);
+static double getRate(char const * const);
 static void setDefaultModuleOption(void);
 static int  getIpAndCidrFromString(char const * const, T50_tmp_addr_t *);
+static int  parseOptions(int, char **, int);
+static int  isRunOption(int);
+static void parseTarget(char *);
+static int  parseStreams(char *);
+
+/* --stream arguments, parsed after the command line (see parseStreams()). */
+static char    *stream_args[MAXIMUM_STREAMS];
+static unsigned num_stream_args = 0;
 
 /* CLI options configuration */
 struct config_options *getConfigOptions(int argc, char **argv)
+{
+  setDefaultModuleOption();
+
+  if (!parseOptions(argc, argv, FALSE))
+    return NULL;
+
+  /* Checking the command line interface options. */
+  if (optind >= argc)
+  {
+    /* NOTE: Replayed packets keep their destinations, without a target.
+             --targets replaces it and streams may have their own. */
+    if (co.replay == NULL && co.targets == NULL && num_stream_args == 0)
+    {
+      ERROR("t50 what? try --help for usage");
+      return NULL;
+    }
+
+    co.bits = 32;
+  }
+  else
+    parseTarget(argv[optind]);
+
+  return parseStreams(argv[0]) ? &co : NULL;
+}
+
+/* Parses the options of the command line or, if 'stream', of a --stream. */
+static int parseOptions(int argc, char **argv, int stream)
 {
   int cli_opts;
   int counter;
+  int longindex;
 
   char  *optionp;
   char *tmp_ptr;
   char **tokens;
 
-  /* Used by getIpAndCidrFromString() call. */
-  T50_tmp_addr_t addr;
-
-  setDefaultModuleOption();
-
   /* Checking command line interface options. */
-  while ( (cli_opts = getopt_long(argc, argv, "s:12345678FSRPAUECW:Bvh?", long_opt, NULL)) != -1 )
+  while ( (cli_opts = getopt_long(argc, argv, "s:12345678FSRPAUECW:Bvh?", long_opt, &longindex)) != -1 )
   {
+    /* NOTE: Options shared by all streams are long options only. */
+    if (stream && isRunOption(cli_opts))
+    {
+      fprintf(stderr, "%s: --%s can't be set on a stream\n", PACKAGE, long_opt[longindex].name);
+      return FALSE;
+    }
+
     switch (cli_opts)
     {
       /* XXX COMMON OPTIONS */
@@ -418,6 +497,123 @@ struct config_options *getConfigOptions(int argc, char **argv)
       case OPTION_TURBO:        co.turbo        = TRUE; break;
 #endif  /* __HAVE_TURBO__ */
 
+      case OPTION_THREADS:      co.threads      = atoi(optarg); break;
+      case OPTION_BATCH:        co.batch        = atoi(optarg); break;
+      case OPTION_NO_TEMPLATE:  co.no_template  = TRUE; break;
+      case OPTION_FORCE_TEMPLATE: co.force_template = TRUE; break;
+      case OPTION_POOL:         co.pool         = atoi(optarg); break;
+      case OPTION_BURST:        co.burst        = atoi(optarg); break;
+      case OPTION_STATS:        co.stats        = atof(optarg); break;
+      case OPTION_BENCH:        co.bench        = TRUE; break;
+      case OPTION_PAYLOAD_SIZE: co.payload_size = atoi(optarg); break;
+      case OPTION_PAYLOAD_FILE: co.payload_file = optarg; break;
+      case OPTION_SIZES:        co.sizes        = optarg; break;
+      case OPTION_REPLAY:       co.replay       = optarg; break;
+      case OPTION_REPLAY_SPEED: co.replay_speed = atof(optarg); break;
+      case OPTION_TARGETS:      co.targets      = optarg; break;
+      case OPTION_PROTOCOL_MIX: co.protocol_mix = optarg; break;
+      case OPTION_STREAM:
+        if (num_stream_args == MAXIMUM_STREAMS)
+        {
+          fprintf(stderr, "%s: too many streams (up to %d)\n", PACKAGE, MAXIMUM_STREAMS);
+          return FALSE;
+        }
+        stream_args[num_stream_args++] = optarg;
+        break;
+      case OPTION_RATE:
+        if ((co.rate = getRate(optarg)) <= 0)
+        {
+          fprintf(stderr, "%s: invalid rate '%s'\n", PACKAGE, optarg);
+          return FALSE;
+        }
+        break;
+      case OPTION_BITRATE:
+        if ((co.bitrate = getRate(optarg)) <= 0)
+        {
+          fprintf(stderr, "%s: invalid bit rate '%s'\n", PACKAGE, optarg);
+          return FALSE;
+        }
+        break;
+      case OPTION_TXTIME:
+        if (!strcasecmp(optarg, "etf"))
+          co.txtime = TXTIME_ETF;
+        else if (!strcasecmp(optarg, "fq"))
+          co.txtime = TXTIME_FQ;
+        else
+        {
+          fprintf(stderr, "%s: unknown transmit time qdisc '%s' (etf or fq)\n", PACKAGE, optarg);
+          return FALSE;
+        }
+        break;
+      case OPTION_DEST_ORDER:
+        if (!strcasecmp(optarg, "random"))
+          co.dest_order = DEST_RANDOM;
+        else if (!strcasecmp(optarg, "sequential"))
+          co.dest_order = DEST_SEQUENTIAL;
+        else if (!strcasecmp(optarg, "permutation"))
+          co.dest_order = DEST_PERMUTATION;
+        else
+        {
+          fprintf(stderr, "%s: unknown destination order '%s' (random, sequential or permutation)\n", PACKAGE, optarg);
+          return FALSE;
+        }
+        break;
+      case OPTION_DEST_SHARDS:
+        if (!strcasecmp(optarg, "strided"))
+          co.dest_shards = SHARD_STRIDED;
+        else if (!strcasecmp(optarg, "contiguous"))
+          co.dest_shards = SHARD_CONTIGUOUS;
+        else
+        {
+          fprintf(stderr, "%s: unknown destination shards '%s' (strided or contiguous)\n", PACKAGE, optarg);
+          return FALSE;
+        }
+        break;
+      case OPTION_RNG:
+        if ((counter = getRngIndex(optarg)) < 0)
+        {
+          fprintf(stderr, "%s: unknown random number generator '%s'. Try --list-rngs\n", PACKAGE, optarg);
+          return FALSE;
+        }
+        co.rng = counter;
+        break;
+
+      /* XXX OUTPUT OPTIONS */
+      case OPTION_BACKEND:
+        if ((counter = getBackendIndex(optarg)) < 0)
+        {
+          fprintf(stderr, "%s: unknown backend '%s'. Try --list-backends\n", PACKAGE, optarg);
+          return FALSE;
+        }
+        co.backend = counter;
+        break;
+      case OPTION_INTERFACE:
+        strncpy(co.iface, optarg, IFNAMSIZ - 1);
+        break;
+      case OPTION_DST_MAC:
+        if (sscanf(optarg, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx",
+                   &co.dst_mac[0], &co.dst_mac[1], &co.dst_mac[2],
+                   &co.dst_mac[3], &co.dst_mac[4], &co.dst_mac[5]) != ETH_ALEN)
+        {
+          fprintf(stderr, "%s: invalid MAC address '%s'\n", PACKAGE, optarg);
+          return FALSE;
+        }
+        break;
+      case OPTION_QDISC_BYPASS: co.qdisc_bypass = TRUE; break;
+      case OPTION_QUEUE:        co.queue        = atoi(optarg); break;
+      case OPTION_OUTPUT:       co.output       = optarg; break;
+      case OPTION_PCAP_ETHER:   co.pcap_ether   = TRUE; break;
+
+      case OPTION_LIST_BACKEND:
+        listBackends();
+        exit(EXIT_SUCCESS);
+        break;
+
+      case OPTION_LIST_RNG:
+        listRngs();
+        exit(EXIT_SUCCESS);
+        break;
+
       case OPTION_LIST_PROTOCOL:
         listProtocols();
         exit(EXIT_SUCCESS);
@@ -461,7 +657,7 @@ struct config_options *getConfigOptions(int argc, char **argv)
                 "%s(): Protocol %s is not implemented\n",
                 __FUNCTION__,
                 optarg);
-            return NULL;
+            return FALSE;
           }
 
           if (strcasecmp(tokens[counter], "T50") == 0)
@@ -789,26 +985,65 @@ struct config_options *getConfigOptions(int argc, char **argv)
 
       case 'v':
         show_version();
-        return NULL;
+        return FALSE;
 
       /* XXX HELP/USAGE MESSAGE */
       case 'h':
       case '?':
       default:
         usage();
-        return NULL;
+        return FALSE;
     }
   }
 
-  /* Checking the command line interface options. */
-  if (optind >= argc)
+  return TRUE;
+}
+
+/* TRUE for the options shared by all streams (see parseStreams()). */
+static int isRunOption(int option)
+{
+  switch (option)
   {
-    ERROR("t50 what? try --help for usage");
-    return NULL;
+#ifdef  __HAVE_TURBO__
+    case OPTION_TURBO:
+#endif  /* __HAVE_TURBO__ */
+    case OPTION_THREADS:
+    case OPTION_BATCH:
+    case OPTION_POOL:
+    case OPTION_TXTIME:
+    case OPTION_STATS:
+    case OPTION_BENCH:
+    case OPTION_PAYLOAD_FILE:
+    case OPTION_REPLAY:
+    case OPTION_REPLAY_SPEED:
+    case OPTION_RNG:
+    case OPTION_TARGETS:
+    case OPTION_PROTOCOL_MIX:
+    case OPTION_STREAM:
+    case OPTION_LIST_RNG:
+    case OPTION_BACKEND:
+    case OPTION_INTERFACE:
+    case OPTION_DST_MAC:
+    case OPTION_QDISC_BYPASS:
+    case OPTION_QUEUE:
+    case OPTION_OUTPUT:
+    case OPTION_PCAP_ETHER:
+    case OPTION_LIST_BACKEND:
+      return TRUE;
   }
 
+  return FALSE;
+}
+
+/* Sets the destination address and CIDR bits from 'target' (HOST[/BITS]). */
+static void parseTarget(char *target)
+{
+  /* Used by getIpAndCidrFromString() call. */
+  T50_tmp_addr_t addr;
+  char *tmp_ptr;
+
   /* Get host and cidr. */
-  if (getIpAndCidrFromString(argv[optind], &addr))
+  if (getIpAndCidrFromString(target, &addr))
   {
     /* If ok, then set values directly to "options" structure. */
     co.bits = addr.cidr;
@@ -818,15 +1053,64 @@ struct config_options *getConfigOptions(int argc, char **argv)
   {
     /* Otherwise, probably it's a name. Try to resolve it. 
        '/' still marks the optional cidr here. */
-    tmp_ptr = strtok(argv[optind], "/");  /* NOTE: tmp_ptr is never null at this point! */
+    tmp_ptr = strtok(target, "/");  /* NOTE: tmp_ptr is never null at this point! */
     co.ip.daddr = resolv(tmp_ptr);
     if ((tmp_ptr = strtok(NULL, "/")) != NULL)
       co.bits = atoi(tmp_ptr);
     else
       co.bits = 32;
   }
+}
+
+/* Parses each --stream as more options (and a target) over the command line
+   ones. 'name' is the program name, for getopt_long() messages.
+   NOTE: The copies of the arguments are kept for the whole run: Options
+         (--sizes, ...) point to them. */
+static int parseStreams(char *name)
+{
+  struct config_options main_co;
+  char *copy, *arg, *save;
+  char **args;
+  unsigned i;
+  int argc;
+
+  main_co = co;
+
+  for (i = 0; i < num_stream_args; i++)
+  {
+    /* Blanks separate the options: At most one every two characters. */
+    if ((copy = strdup(stream_args[i])) == NULL ||
+        (args = malloc((strlen(copy) / 2 + 3) * sizeof(char *))) == NULL)
+    {
+      ERROR("Error allocating streams");
+      return FALSE;
+    }
+
+    args[0] = name;
+    argc = 1;
+    for (arg = strtok_r(copy, " \t", &save); arg != NULL; arg = strtok_r(NULL, " \t", &save))
+      args[argc++] = arg;
+    args[argc] = NULL;
+
+    /* Options not given keep their command line values. */
+    co = main_co;
+    optind = 0;                     /* NOTE: Restarts getopt_long() (glibc). */
+
+    if (!parseOptions(argc, args, TRUE))
+    {
+      fprintf(stderr, "%s: on stream '%s'\n", PACKAGE, stream_args[i]);
+      return FALSE;
+    }
+
+    if (optind < argc)
+      parseTarget(args[optind]);
+
+    if (!addStream(&co, stream_args[i]))
+      return FALSE;
+  }
 
-  return &co;
+  co = main_co;
+  return TRUE;
 }
 
 /* Used on getsubopt(), below */
@@ -865,6 +1149,83 @@ static void listProtocols(void)
            ptbl->description);
 }
 
+/* List output backends on backends table */
+static void listBackends(void)
+{
+  backends_table_t *ptbl;
+  int i;
+
+  puts("List of supported backends:");
+
+  for (i = 1, ptbl = backend_table; ptbl->open != NULL; ptbl++, i++)
+    printf("\t%2d BACKEND = %-6s (%s)\n",
+           i,
+           ptbl->name,
+           ptbl->description);
+}
+
+/* Returns the index of backend 'name' on backends table, or -1 if not found. */
+static int getBackendIndex(char const * const name)
+{
+  backends_table_t *ptbl;
+  int i;
+
+  for (i = 0, ptbl = backend_table; ptbl->open != NULL; ptbl++, i++)
+    if (strcasecmp(ptbl->name, name) == 0)
+      return i;
+
+  return -1;
+}
+
+/* List random number generators on rng table */
+static void listRngs(void)
+{
+  rng_table_t *ptbl;
+  int i;
+
+  puts("List of supported random number generators:");
+
+  for (i = 1, ptbl = rng_table; ptbl->fill != NULL; ptbl++, i++)
+    printf("\t%2d RNG = %-7s (%s)\n",
+           i,
+           ptbl->name,
+           ptbl->description);
+}
+
+/* Returns the index of random number generator 'name' on rng table, or -1 if not found. */
+static int getRngIndex(char const * const name)
+{
+  rng_table_t *ptbl;
+  int i;
+
+  for (i = 0, ptbl = rng_table; ptbl->fill != NULL; ptbl++, i++)
+    if (strcasecmp(ptbl->name, name) == 0)
+      return i;
+
+  return -1;
+}
+
+/* Converts a rate with an optional k, M or G suffix (ex: 250k, 3G).
+   Returns -1 if it's not valid. */
+static double getRate(char const * const str)
+{
+  double value;
+  char *end;
+
+  value = strtod(str, &end);
+  switch (*end)
+  {
+    case 'k': case 'K': value *= 1e3; end++; break;
+    case 'm': case 'M': value *= 1e6; end++; break;
+    case 'g': case 'G': value *= 1e9; end++; break;
+  }
+
+  if (end == str || *end != '\0')
+    return -1;
+
+  return value;
+}
+
 /* NOTE: Ugly hack, but necessary! */
 static void setDefaultModuleOption(void)
 {
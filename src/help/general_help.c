@@ -19,6 +19,13 @@
 
 #include <stdio.h>
 
+/* NOTE: Debug builds keep every template (see config.c). */
+#ifdef __HAVE_DEBUG__
+#define FORCE_TEMPLATE_DEFAULT "ON"
+#else
+#define FORCE_TEMPLATE_DEFAULT "OFF"
+#endif
+
 void general_help(void)
 {
   puts("Common Options:\n"
@@ -26,6 +33,28 @@ void general_help(void)
        "    --flood                   This option supersedes the \'threshold\'\n"
        "    --encapsulated            Encapsulated protocol (GRE)      (default OFF)\n"
        " -B,--bogus-csum              Bogus checksum                   (default OFF)\n"
+       "    --threads NUM             Number of worker threads         (default 1)\n"
+       "    --no-template             Build every packet from scratch  (default OFF)\n"
+       "    --force-template          Keep templates, even if slower   (default " FORCE_TEMPLATE_DEFAULT ")\n"
+       "    --pool NUM                Pre-built packets per protocol   (default 0)\n"
+       "    --rate NUM[kMG]           Packets per second               (default max)\n"
+       "    --bitrate NUM[kMG]        Bits per second                  (default max)\n"
+       "    --burst NUM               Packets sent back to back        (default batch)\n"
+       "    --txtime QDISC            Paced by the qdisc (etf or fq)   (default OFF)\n"
+       "    --stats SECONDS           Show rates every SECONDS         (default OFF)\n"
+       "    --bench                   Time the packet building only    (default OFF)\n"
+       "    --payload-size NUM        ICMP, UDP and TCP payload bytes  (default 0)\n"
+       "    --payload-file FILE       Payload bytes mapped from FILE   (default random)\n"
+       "    --sizes LIST              IP packet sizes (ex: imix)       (default OFF)\n"
+       "    --replay FILE             Send the packets of a pcap FILE  (default OFF)\n"
+       "    --replay-speed NUM        Replay timing (1: as captured)   (default max)\n"
+       "    --rng NAME                Random number generator          (default xoshiro)\n"
+       "    --list-rngs               List all random number generators\n"
+       "    --dest-order ORDER        random, sequential, permutation  (default random)\n"
+       "    --dest-shards LAYOUT      strided, contiguous              (default strided)\n"
+       "    --targets FILE            Weighted targets (HOST[/BITS] N) (default OFF)\n"
+       "    --protocol-mix LIST       T50 protocol weights (ex: UDP:3) (default 1 each)\n"
+       "    --stream OPTIONS          Extra traffic stream (quoted)    (default OFF)\n"
 #ifdef  __HAVE_TURBO__
 			 "     --turbo                   Extend the performance           (default OFF)\n"
 #endif  /* __HAVE_TURBO__ */
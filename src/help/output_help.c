@@ -0,0 +1,34 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+
+void output_help(void)
+{
+  puts("Output Options:\n"
+       "    --backend NAME            Output backend                   (default raw)\n"
+       "    --list-backends           List all available backends\n"
+       "    --batch NUM               Packets per send system call     (default 1)\n"
+       "    --interface NAME          Output interface                 (default by route)\n"
+       "    --dst-mac MAC             Next hop MAC address             (default by ARP)\n"
+       "    --qdisc-bypass            Bypass the queueing discipline   (default OFF)\n"
+       "    --queue NUM               Interface queue used by xdp      (default 0)\n"
+       "    --output FILE             File written by pcap and pcapng  (- for stdout)\n"
+       "    --pcap-ether              Ethernet frames on pcap files    (default raw IP)\n");
+}
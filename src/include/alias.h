@@ -0,0 +1,51 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __ALIAS_INCLUDED__
+#define __ALIAS_INCLUDED__
+
+#include <typedefs.h>
+#include <random.h>
+
+/* A column of an alias table (Vose's method), kept at the start of the
+   entries it draws (see drawAlias()). */
+typedef struct {
+  uint32_t threshold;               /* draws (out of 2^32, minus 1) of this one */
+  uint32_t alias;                   /* entry taken on the other draws   */
+} alias_t;
+
+/* Builds the columns of 'n' entries, 'stride' bytes apart, from their 'weights'
+   (changed). */
+extern int buildAliasTable(alias_t *, uint32_t, size_t, double *);
+
+/* Draws an entry of the table built by buildAliasTable(): A column picked at
+   random, then either its own entry or its alias. Two random words, however
+   many entries. */
+static inline uint32_t drawAlias(const alias_t *columns, uint32_t n, size_t stride)
+{
+  const alias_t *c;
+  uint32_t i;
+
+  i = ((uint64_t)__RANDOM() * n) >> 32;
+  c = (const void *)columns + i * stride;
+
+  return __RANDOM() <= c->threshold ? i : c->alias;
+}
+
+#endif
@@ -0,0 +1,139 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __BACKENDS_INCLUDED__
+#define __BACKENDS_INCLUDED__
+
+#include <typedefs.h>
+#include <config.h>
+
+/* NOTE: Output backends are selected with --backend. sock.c dispatches
+         createSocket(), sendPacket(), flushPackets() and closeSocket() to them.
+         'buffer' is optional: Backends sending from their own memory return the
+         place where the next packet must be built (see preparePacket()).
+         'flags' tell backends writing to --output files (BACKEND_FILE), the
+         ones not needing root privileges (BACKEND_NO_ROOT) and the ones
+         sending UDP payloads only (BACKEND_UDP). */
+typedef struct {
+  char *name;
+  char *description;
+  int  (*open)(const struct config_options * const __restrict__);
+  int  (*send)(const void * const, size_t, const struct config_options * const __restrict__);
+  int  (*flush)(void);
+  void (*close)(void);
+  void *(*buffer)(size_t *);
+  unsigned flags;
+} backends_table_t;
+
+#define BACKEND_FILE    1
+#define BACKEND_NO_ROOT 2
+#define BACKEND_UDP     4
+
+#define BEGIN_BACKENDS_TABLE backends_table_t backend_table[] = {
+#define END_BACKENDS_TABLE { NULL, NULL, NULL, NULL, NULL, NULL, NULL, 0 } };
+
+/* 'prefix' is the name prefix of the backend functions (ex: raw -> raw_open, raw_send, ...). */
+#define BACKEND_ENTRY(name,descr,prefix) \
+  { name, descr, prefix##_open, prefix##_send, prefix##_flush, prefix##_close, NULL, 0 },
+
+/* Same as above, for backends with a prefix_buffer function. */
+#define BUFFERED_BACKEND_ENTRY(name,descr,prefix) \
+  { name, descr, prefix##_open, prefix##_send, prefix##_flush, prefix##_close, prefix##_buffer, 0 },
+
+/* Same as BACKEND_ENTRY, for backends writing to files. */
+#define FILE_BACKEND_ENTRY(name,descr,prefix) \
+  { name, descr, prefix##_open, prefix##_send, prefix##_flush, prefix##_close, NULL, BACKEND_FILE | BACKEND_NO_ROOT },
+
+/* Same as BACKEND_ENTRY, for backends not touching the network. */
+#define LOCAL_BACKEND_ENTRY(name,descr,prefix) \
+  { name, descr, prefix##_open, prefix##_send, prefix##_flush, prefix##_close, NULL, BACKEND_NO_ROOT },
+
+/* Same as BACKEND_ENTRY, for backends sending the UDP payload only (the kernel builds the headers). */
+#define UDP_BACKEND_ENTRY(name,descr,prefix) \
+  { name, descr, prefix##_open, prefix##_send, prefix##_flush, prefix##_close, NULL, BACKEND_UDP },
+
+extern backends_table_t backend_table[];
+
+/* Link layer information used by the backends that build their own frames. */
+struct link_info {
+  char      name[IFNAMSIZ];         /* interface name              */
+  int       ifindex;                /* interface index             */
+  unsigned  mtu;                    /* interface MTU               */
+  uint8_t   src_mac[ETH_ALEN];      /* interface MAC address       */
+  uint8_t   dst_mac[ETH_ALEN];      /* next hop MAC address        */
+};
+
+extern int getLinkInfo(const struct config_options * const __restrict__, struct link_info *);
+
+/* Creates a raw IP socket (IP_HDRINCL). Returns -1 on error. */
+extern socket_t openRawSocket(void);
+
+/* Used by backends to decide, based on errno, if a failed send must be retried. */
+extern int retrySend(int *);
+
+/* Used by backends waiting for the kernel, as retrySend() waits on ENOBUFS. */
+extern void backoffSend(int);
+
+/* Backends functions prototypes. */
+extern int  raw_open (const struct config_options * const __restrict__);
+extern int  raw_send (const void * const, size_t, const struct config_options * const __restrict__);
+extern int  raw_flush(void);
+extern void raw_close(void);
+
+extern int  ring_open (const struct config_options * const __restrict__);
+extern int  ring_send (const void * const, size_t, const struct config_options * const __restrict__);
+extern int  ring_flush(void);
+extern void ring_close(void);
+
+extern int  uring_open (const struct config_options * const __restrict__);
+extern int  uring_send (const void * const, size_t, const struct config_options * const __restrict__);
+extern int  uring_flush(void);
+extern void uring_close(void);
+
+extern int   xdp_open  (const struct config_options * const __restrict__);
+extern int   xdp_send  (const void * const, size_t, const struct config_options * const __restrict__);
+extern int   xdp_flush (void);
+extern void  xdp_close (void);
+extern void *xdp_buffer(size_t *);
+
+extern int  pcap_open  (const struct config_options * const __restrict__);
+extern int  pcap_send  (const void * const, size_t, const struct config_options * const __restrict__);
+extern int  pcap_flush (void);
+extern void pcap_close (void);
+
+extern int  pcapng_open (const struct config_options * const __restrict__);
+extern int  pcapng_send (const void * const, size_t, const struct config_options * const __restrict__);
+extern int  pcapng_flush(void);
+extern void pcapng_close(void);
+
+extern int  null_open (const struct config_options * const __restrict__);
+extern int  null_send (const void * const, size_t, const struct config_options * const __restrict__);
+extern int  null_flush(void);
+extern void null_close(void);
+
+extern int  gso_open (const struct config_options * const __restrict__);
+extern int  gso_send (const void * const, size_t, const struct config_options * const __restrict__);
+extern int  gso_flush(void);
+extern void gso_close(void);
+
+/* Moves the messages to the standard error, before writing packets to the standard output. */
+extern int  pcapStdout(void);
+/* --- add yours here */
+
+#endif
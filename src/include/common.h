@@ -41,6 +41,7 @@
 #include <sys/time.h>
 #include <sys/socket.h>
 #include <sys/resource.h>
+#include <net/if.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
@@ -61,12 +62,28 @@
 #include <config.h>
 #include <help.h>
 #include <modules.h>
+#include <backends.h>
+#include <worker.h>
+#include <template.h>
+#include <random.h>
+#include <alias.h>
+#include <targets.h>
+#include <pool.h>
+#include <payload.h>
+#include <sizes.h>
+#include <mix.h>
+#include <stream.h>
+#include <replay.h>
+#include <pacing.h>
+#include <txtime.h>
+#include <stats.h>
+#include <bench.h>
 
 /* NOTE: Protocols and modules definitions are on modules.h now. */
 
-/* The packet buffer. Reallocated as needed! */
-extern void *packet;
-extern size_t current_packet_size; /* available if necessary! updated by alloc_packet(). */
+/* The packet buffer. Reallocated as needed! Each worker thread has its own. */
+extern __thread void *packet;
+extern __thread size_t current_packet_size; /* available if necessary! updated by alloc_packet(). */
 
 /* NOTE: Since this is not a macro, it's here insted of defines.h. */
 extern uint32_t NETMASK_RND(uint32_t);
@@ -74,19 +91,29 @@ extern uint32_t NETMASK_RND(uint32_t);
 /* Realloc packet as needed. Used on module functions. */
 extern void alloc_packet(size_t);
 
+/* Makes modules build the packet on a buffer owned by the output backend. */
+extern void set_packet_buffer(void *, size_t);
+
 /* Common routines used by code */
 extern struct cidr *config_cidr(uint32_t, in_addr_t);
+extern void initDestinations(dest_iter_t *, const struct cidr *, uint32_t, uint32_t, unsigned, unsigned);
+extern in_addr_t nextDestination(dest_iter_t *);  /* Next destination address (network order). */
+extern void printCoverage(const struct config_options * const __restrict__, uint64_t, unsigned);
 extern uint16_t cksum(void *, size_t);  /* Checksum calc. */
+extern int checkCksum(void);  /* Checks the checksum kernels (t50-bench --check). */
+extern uint16_t updateCksum(uint16_t, uint32_t);  /* Incremental checksum update (RFC 1624). */
+extern uint32_t cksumDelta(const void *, const void *, size_t, int);
 extern in_addr_t resolv(char *);  /* Resolve name to ip address. */
-extern int createSocket(void); /* Creates the sending socket */
+extern int createSocket(const struct config_options * const __restrict__); /* Creates the sending socket */
 extern void closeSocket(void);  /* Close the previously created socket */
 /* Send the actual packet from buffer, with size bytes, using config options. */
 extern int sendPacket(const void * const, size_t, const struct config_options * const __restrict__);
+extern int flushPackets(void);  /* Send packets still queued by sendPacket() */
+extern int preparePacket(void); /* Select the buffer for the next packet */
 extern void show_version(void); /* Prints version info. */
 extern void usage(void);        /* Prints usage message */
 
-#ifdef __HAVE_RDRAND__
-extern uint32_t readrand(void);
-#endif
+/* When not NULL, RANDOM() calls it instead of the random source. */
+extern __thread uint32_t (*random_hook)(void);
 
 #endif /* __COMMON_H */
@@ -34,8 +34,41 @@ enum {
 #ifdef  __HAVE_TURBO__
   OPTION_TURBO,
 #endif  /* __HAVE_TURBO__ */
+  OPTION_BATCH,
+  OPTION_THREADS,
+  OPTION_NO_TEMPLATE,
+  OPTION_FORCE_TEMPLATE,
+  OPTION_POOL,
+  OPTION_RATE,
+  OPTION_BITRATE,
+  OPTION_BURST,
+  OPTION_TXTIME,
+  OPTION_STATS,
+  OPTION_BENCH,
+  OPTION_PAYLOAD_SIZE,
+  OPTION_PAYLOAD_FILE,
+  OPTION_SIZES,
+  OPTION_REPLAY,
+  OPTION_REPLAY_SPEED,
+  OPTION_RNG,
+  OPTION_DEST_ORDER,
+  OPTION_DEST_SHARDS,
+  OPTION_TARGETS,
+  OPTION_PROTOCOL_MIX,
+  OPTION_STREAM,
+  OPTION_LIST_RNG,
   OPTION_LIST_PROTOCOL,
 
+  /* XXX OUTPUT OPTIONS                            */
+  OPTION_BACKEND,
+  OPTION_INTERFACE,
+  OPTION_DST_MAC,
+  OPTION_QDISC_BYPASS,
+  OPTION_QUEUE,
+  OPTION_OUTPUT,
+  OPTION_PCAP_ETHER,
+  OPTION_LIST_BACKEND,
+
   /* XXX DCCP, TCP & UDP HEADER OPTIONS            */
   OPTION_SOURCE,
   OPTION_DESTINATION,
@@ -260,21 +293,75 @@ enum {
   OPTION_OSPF_AUTH_SEQUENCE,
 };
 
+/* --txtime qdiscs. */
+enum { TXTIME_OFF, TXTIME_ETF, TXTIME_FQ };
+
+/* --dest-order strategies. */
+enum { DEST_RANDOM, DEST_SEQUENTIAL, DEST_PERMUTATION, DEST_TARGETS };
+
+/* --dest-shards layouts. */
+enum { SHARD_STRIDED, SHARD_CONTIGUOUS };
+
+#define CIDR_PERMUTATION_ROUNDS 4
+
 /* Config structures */
 struct cidr {
   uint32_t  hostid;                 /* hosts identifiers           */
   in_addr_t __1st_addr;             /* first IP address            */
+  uint32_t  perm_keys[CIDR_PERMUTATION_ROUNDS];
 };
 
+/* Destination addresses of a worker, in --dest-order (see nextDestination()).
+   Its shard holds the hosts base + k * stride, 0 <= k < count. */
+typedef struct {
+  const struct cidr *cidr;
+  uint32_t  order;                  /* DEST_*                      */
+  uint32_t  base;                   /* first host of the shard     */
+  uint32_t  stride;
+  uint32_t  count;                  /* hosts on the shard          */
+  uint32_t  perm_bits;              /* permutation of 2^perm_bits >= count hosts */
+  uint32_t  index;                  /* position on the cycle       */
+} dest_iter_t;
+
 struct config_options {
   /* XXX COMMON OPTIONS                                            */
   threshold_t threshold;            /* amount of packets           */
   int       flood;                  /* flood                       */
   int       encapsulated;           /* GRE encapsulated            */
   int       bogus_csum;             /* bogus packet checksum       */
+  unsigned  batch;                  /* packets per sendmmsg() call */
 #ifdef  __HAVE_TURBO__
   int       turbo;                  /* duplicate the attack        */
 #endif  /* __HAVE_TURBO__ */
+  unsigned  threads;                /* number of worker threads    */
+  int       no_template;            /* don't use packet templates  */
+  int       force_template;         /* keep them, even if slower   */
+  unsigned  pool;                   /* pre-generated packets/proto */
+  double    rate;                   /* packets per second (0: max) */
+  double    bitrate;                /* bits per second    (0: max) */
+  unsigned  burst;                  /* rate control burst          */
+  uint32_t  txtime;                 /* TXTIME_* (kernel pacing)    */
+  double    stats;                  /* seconds between statistics  */
+  int       bench;                  /* generation benchmark        */
+  uint32_t  payload_size;           /* payload bytes (ICMP/UDP/TCP)*/
+  char     *payload_file;           /* payload mapped from a file  */
+  char     *sizes;                  /* packet sizes distribution   */
+  char     *replay;                 /* pcap file replayed          */
+  double    replay_speed;           /* replay timing (0: max)      */
+  uint32_t  rng;                    /* index on rng_table          */
+  uint32_t  dest_order;             /* DEST_* (destination order)  */
+  uint32_t  dest_shards;            /* SHARD_* (workers' hosts)    */
+  char     *targets;                /* weighted target list file   */
+  char     *protocol_mix;           /* T50 protocol weights        */
+
+  /* XXX OUTPUT OPTIONS                                            */
+  uint32_t  backend;                /* index on backend_table      */
+  char      iface[IFNAMSIZ];        /* output interface            */
+  uint8_t   dst_mac[ETH_ALEN];      /* next hop MAC address        */
+  int       qdisc_bypass;           /* bypass the qdisc layer      */
+  uint32_t  queue;                  /* interface queue (AF_XDP)    */
+  char     *output;                 /* file backends output file   */
+  int       pcap_ether;             /* Ethernet headers on files   */
 
   /* XXX DCCP, TCP & UDP HEADER OPTIONS                            */
   uint16_t  source;                 /* general source port         */
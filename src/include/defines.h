@@ -32,6 +32,30 @@
 /* Initial packet buffer preallocated size (1 kB). */
 #define INITIAL_PACKET_SIZE 1024
 
+/* Maximum number of packets queued for a single sendmmsg() call (UIO_MAXIOV). */
+#define MAXIMUM_BATCH 1024
+
+/* Maximum number of worker threads. */
+#define MAXIMUM_THREADS 256
+
+/* Maximum number of pre-generated packets per protocol. */
+#define MAXIMUM_POOL 1048576
+
+/* Maximum packets sent back to back by the rate control. */
+#define MAXIMUM_BURST 1048576
+
+/* Maximum number of --stream options. */
+#define MAXIMUM_STREAMS 16
+
+/* Maximum payload size: IP packets, with the biggest headers, fit on 64 kB. */
+#define MAXIMUM_PAYLOAD 65000
+
+/* Used to keep per thread data on its own cache lines. */
+#define CACHE_LINE_SIZE 64
+
+/* Maximum number of tries to send the packet. */
+#define MAX_SENDTO_TRIES  100
+
 /* #define RAND_MAX 2147483647 */ /* NOTE: Already defined @ stdlib.h */
 #define CIDR_MINIMUM 8
 #define CIDR_MAXIMUM 32 // fix #7
@@ -68,13 +92,12 @@
 #define TEST_BITS(x,bits) ((x) & (bits))
 
 /* Randomizer macros and function */
-#ifdef __HAVE_RDRAND__
-#define RANDOM() readrand()
-#define SRANDOM(x) {}
-#else
-#define RANDOM() random()
-#define SRANDOM(x) { srandom((x)); }
-#endif
+/* NOTE: Takes the next word of the ring filled by the --rng generator (see random.c). */
+#define __RANDOM() (__builtin_expect(random_next < RANDOM_RING_SIZE, 1) ? \
+                      random_ring[random_next++] : refillRandom())
+
+/* NOTE: The template compiler (template.c) takes over RANDOM() while it builds packets. */
+#define RANDOM() (__builtin_expect(random_hook == NULL, 1) ? __RANDOM() : random_hook())
 
 #define __RND(foo) (((foo) == 0) ? RANDOM() : (foo))
 #define INADDR_RND(foo) __RND((foo))
@@ -87,8 +110,5 @@
 #define ERROR(s) fprintf(stderr, "%s: %s\n", PACKAGE, s);
 #endif
 
-/* Used to test if "pid" from fork() is from a child process. */
-#define IS_CHILD_PID(p) ((p) == 0)
-
 #endif
 
@@ -24,6 +24,7 @@
    Add usage function definition for protocol at src/help/ directory.
    Change Makefile and src/usage.c. */
 extern void general_help(void);
+extern void output_help(void);
 extern void gre_help(void);
 extern void tcp_udp_dccp_help(void);
 extern void ip_help(void);
@@ -0,0 +1,35 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __MIX_INCLUDED__
+#define __MIX_INCLUDED__
+
+#include <typedefs.h>
+#include <config.h>
+
+/* Modules of --protocol T50, in sending order (indexes on mod_table). Read only
+   after initMix(): Packet n is built by mod_table[mix_schedule[n % mix_length]]. */
+extern uint8_t  *mix_schedule;
+extern uint32_t  mix_length;
+
+/* Builds the schedule from --protocol-mix (every module once, without it). */
+extern int  initMix(const struct config_options * const __restrict__);
+extern void freeMix(void);
+
+#endif
@@ -0,0 +1,65 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __PACING_INCLUDED__
+#define __PACING_INCLUDED__
+
+#include <time.h>
+#include <typedefs.h>
+#include <config.h>
+
+/* Per worker token buckets for --rate (packets) and --bitrate (bits).
+   Times are in nanoseconds since the worker started. */
+typedef struct {
+  int       active;                 /* rates or --replay-speed    */
+  unsigned  burst;                  /* packets sent back to back   */
+  double    packet_ns;              /* time per packet (0: none)   */
+  double    bit_ns;                 /* time per bit    (0: none)   */
+  double    packet_tat;             /* when the buckets are full   */
+  double    bit_tat;
+  uint64_t  start;
+  int       started;                /* first packet paced          */
+  int       txtime;                 /* --txtime: the qdisc waits   */
+  clockid_t clock;
+} pacer_t;
+
+/* Departure time of the packet just paced, on the --txtime clock (0 without --txtime). */
+extern __thread uint64_t pacing_txtime;
+
+/* Gives the worker its share of the rates ('workers' workers). */
+extern void initPacer(pacer_t *, const struct config_options * const __restrict__, unsigned);
+
+/* Waits until a 'size' bytes packet may be sent (with --txtime, until it's
+   PACING_TXTIME_LEAD_NS before its departure time). Returns FALSE if the
+   packets queued before sleeping couldn't be sent. */
+extern int pace(pacer_t *, size_t);
+
+/* Waits until 't' nanoseconds since the worker started (--replay-speed),
+   the same way. */
+extern int paceAt(pacer_t *, uint64_t);
+
+/* When the next packet may go, on the pacer's clock (without the --burst of
+   --bitrate), and the time on that clock. */
+extern uint64_t pacerDue(const pacer_t *);
+extern uint64_t pacerClock(const pacer_t *);
+
+/* CLOCK_MONOTONIC_RAW, in nanoseconds. */
+extern uint64_t pacingClock(void);
+
+#endif
@@ -0,0 +1,63 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __PAYLOAD_INCLUDED__
+#define __PAYLOAD_INCLUDED__
+
+#include <string.h>
+#include <typedefs.h>
+#include <config.h>
+
+/* Application payload (--payload-size and --payload-file), attached by the
+   ICMP, UDP and TCP modules after their headers. 'payload_data' holds
+   'payload_length' bytes, read only after loadPayload(). Packets carry the
+   first 'payload_size' of them (all, unless --size draws it per packet, see
+   setPayloadSize()). */
+extern const uint8_t  *payload_data;
+extern size_t          payload_length;
+extern __thread size_t payload_size;
+
+/* Maps --payload-file or generates --payload-size random bytes (nothing if
+   there is no payload). */
+extern int  loadPayload(const struct config_options * const __restrict__);
+extern void freePayload(void);
+
+/* Makes the payload at least 'length' bytes long (random bytes, or zeros after
+   the --payload-file ones). */
+extern int  extendPayload(size_t length);
+
+/* Checksum of 'length' bytes at 'header', the payload after them and 'trailer' bytes
+   after the payload (ex: the pseudo header). The payload isn't summed again. */
+extern uint16_t payloadCksum(void *header, size_t length, size_t trailer);
+
+/* Payload bytes of the next packets built by the calling thread (up to 'payload_length'). */
+static inline void setPayloadSize(size_t size)
+{
+  payload_size = size;
+}
+
+/* Copies the payload to 'p'. Returns the address after it. */
+static inline void *putPayload(void *p)
+{
+  if (payload_size)
+    memcpy(p, payload_data, payload_size);
+  return p + payload_size;
+}
+
+#endif
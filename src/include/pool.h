@@ -0,0 +1,45 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __POOL_INCLUDED__
+#define __POOL_INCLUDED__
+
+#include <typedefs.h>
+#include <config.h>
+
+/* A pre-generated packet: 'size' bytes at 'offset' on the pool arena.
+   'daddr' (network order) is needed by the backends sending to an address. */
+typedef struct {
+  uint32_t  offset;
+  uint32_t  size;
+  in_addr_t daddr;
+  uint32_t  module;                 /* index on mod_table */
+} pool_entry_t;
+
+/* Packets on the pool, in sending order. Read only after buildPool(). */
+extern void         *pool_arena;
+extern pool_entry_t *pool_entries;
+extern size_t        pool_count;
+
+/* Builds --pool packets per protocol on a single buffer (nothing if --pool is 0). */
+extern int buildPool(const struct config_options * const __restrict__, const struct cidr * const);
+
+extern void freePool(void);
+
+#endif
@@ -0,0 +1,69 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __RANDOM_INCLUDED__
+#define __RANDOM_INCLUDED__
+
+#include <typedefs.h>
+#include <config.h>
+
+/* Random words generated at a time, per thread. Multiple of 2 * XOSHIRO_LANES. */
+#define RANDOM_RING_SIZE 256
+
+/* NOTE: Random number generators are selected with --rng. Each one fills
+         the ring of the calling thread, keeping its own (per thread) state.
+         'available' is optional: Generators depending on the CPU tell if
+         they can be used. */
+typedef struct {
+  char *name;
+  char *description;
+  int  (*available)(void);
+  void (*fill)(uint32_t *, size_t);
+} rng_table_t;
+
+extern rng_table_t rng_table[];
+
+/* Ring of random words, consumed by __RANDOM() (see defines.h). */
+extern __thread uint32_t random_ring[RANDOM_RING_SIZE];
+extern __thread unsigned random_next;
+
+/* Selects the --rng generator and seeds it. */
+extern void initRandom(const struct config_options * const __restrict__);
+
+/* Fills the ring of the calling thread and returns its first word. */
+extern uint32_t refillRandom(void);
+
+/* Takes 'count' (up to RANDOM_RING_SIZE) consecutive words of the ring at once,
+   refilling it first if they aren't there. Used by the templates (template.c). */
+static inline const uint32_t *takeRandom(unsigned count)
+{
+  const uint32_t *p;
+
+  if (__builtin_expect(random_next + count > RANDOM_RING_SIZE, 0))
+  {
+    refillRandom();
+    random_next = 0;
+  }
+
+  p = random_ring + random_next;
+  random_next += count;
+  return p;
+}
+
+#endif
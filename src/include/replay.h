@@ -0,0 +1,52 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __REPLAY_INCLUDED__
+#define __REPLAY_INCLUDED__
+
+#include <typedefs.h>
+#include <config.h>
+
+/* A packet of the --replay file: 'size' bytes of IP packet at 'offset' on the
+   mapped file. 'module' is STATS_MODULES for protocols without a module. */
+typedef struct {
+  uint64_t  offset;
+  uint64_t  time;                   /* ns after the first packet, over --replay-speed */
+  uint32_t  size;
+  in_addr_t daddr;                  /* network order                    */
+  uint16_t  l4_check;               /* TCP/UDP checksum offset (0: none) */
+  uint8_t   udp;                    /* a zero UDP checksum stays zero   */
+  uint8_t   module;                 /* index on mod_table               */
+} replay_entry_t;
+
+/* Packets of the file, in its order. Read only after loadReplay(). */
+extern const uint8_t  *replay_data;
+extern replay_entry_t *replay_entries;
+extern size_t          replay_count;
+extern uint64_t        replay_period;  /* time of a pass through the file  */
+extern int             replay_rewrite; /* a target was given               */
+
+/* Maps the --replay pcap file and indexes its IPv4 packets (nothing without --replay). */
+extern int  loadReplay(const struct config_options * const __restrict__);
+extern void freeReplay(void);
+
+/* Copies packet 'e' to 'packet', sent to 'daddr' (network order), fixing its checksums. */
+extern void rewritePacket(const replay_entry_t *, in_addr_t);
+
+#endif
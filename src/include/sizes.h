@@ -0,0 +1,41 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __SIZES_INCLUDED__
+#define __SIZES_INCLUDED__
+
+#include <typedefs.h>
+#include <config.h>
+#include <modules.h>
+
+/* Parses --sizes and finds the headers size of the modules carrying the payload
+   (ICMP, UDP and TCP), making the payload as long as the largest size needs
+   (see extendPayload()). Nothing to do without --sizes. Streams have their own
+   (see current_stream). */
+extern int  initSizes(const struct config_options * const __restrict__);
+extern void freeSizes(void);
+
+/* TRUE if the sizes of module 'ptbl' packets are drawn from --sizes. */
+extern int  hasSizes(modules_table_t *);
+
+/* Draws the size of the next packet of module 'ptbl', setting the payload size
+   of the calling thread. Does nothing if the module doesn't have sizes. */
+extern void drawSize(modules_table_t *);
+
+#endif
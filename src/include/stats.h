@@ -0,0 +1,72 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __STATS_INCLUDED__
+#define __STATS_INCLUDED__
+
+#include <typedefs.h>
+#include <config.h>
+
+#define STATS_MODULES 32            /* more than the registered modules */
+#define STATS_ERRNOS  256
+
+/* Per worker counters. Only the worker writes them and the statistics
+   thread only reads them, so there are no locks or atomic instructions. */
+typedef struct {
+  uint64_t  packets;
+  uint64_t  bytes;
+  uint64_t  retries;                /* sends retried (ENOBUFS, EAGAIN) */
+  uint64_t  cpu_ns;                 /* CPU time (user and system)      */
+  uint64_t  departures;             /* --txtime departures timestamped */
+  uint64_t  departure_ns;           /* sum of their deviations (signed) */
+  uint64_t  departure_abs_ns;       /* sum of their absolute deviations */
+  uint64_t  departure_max_ns;       /* worst one (not summed)          */
+  uint64_t  txtime_dropped;         /* dropped by the qdisc (late)     */
+  uint64_t  modules[STATS_MODULES]; /* packets per module              */
+  uint64_t  stream_packets[MAXIMUM_STREAMS]; /* per --stream           */
+  uint64_t  stream_bytes[MAXIMUM_STREAMS];
+  uint64_t  stream_ns[MAXIMUM_STREAMS];     /* time its share took (not summed) */
+  uint64_t  errors[STATS_ERRNOS];   /* failed sends, by errno          */
+} stats_t;
+
+/* Counters of the calling worker (NULL outside the workers). */
+extern __thread stats_t *worker_stats;
+
+/* NOTE: Relaxed stores of a single writer are plain instructions. They just
+         keep the compiler from tearing or caching the counters. */
+static inline void statsAdd(uint64_t *counter, uint64_t n)
+{
+  __atomic_store_n(counter, *counter + n, __ATOMIC_RELAXED);
+}
+
+/* CPU time of the calling thread, in nanoseconds. */
+extern uint64_t threadCpuTime(void);
+
+/* Counts a failed send (errno 'err') of the calling worker. */
+extern void countSendError(int, int);
+
+/* Starts the thread printing the rates every --stats seconds, if asked to.
+   'stats' points to the first worker's counters, 'stride' bytes apart. */
+extern int  startStats(const struct config_options * const __restrict__, const stats_t *, size_t, unsigned);
+extern void stopStats(void);
+
+/* Prints the totals of the run, which took 'elapsed' nanoseconds. */
+extern void printSummary(const struct config_options * const __restrict__, uint64_t);
+
+#endif
@@ -0,0 +1,51 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __STREAM_INCLUDED__
+#define __STREAM_INCLUDED__
+
+#include <typedefs.h>
+#include <config.h>
+
+/* A --stream: The command line options, changed by its own, and its
+   destinations. Read only after initStreams(). */
+typedef struct {
+  struct config_options co;
+  struct cidr cidr;                 /* its target                      */
+  size_t      payload;              /* payload bytes (without --sizes) */
+  const char *args;                 /* its options, as given           */
+} stream_t;
+
+/* Streams of the run (none without --stream). */
+extern stream_t *streams;
+extern unsigned  num_streams;
+
+/* Stream whose packets the calling thread builds (0 without streams). Selects
+   its --sizes and templates (see drawSize() and buildPacket()). */
+extern __thread unsigned current_stream;
+
+/* Adds a stream with options 'co' (parsed from 'args'). */
+extern int  addStream(const struct config_options * const __restrict__, const char *);
+
+/* Finds the destinations and the payload size of each stream, making the
+   payload as long as the longest one needs (see extendPayload()). */
+extern int  initStreams(void);
+extern void freeStreams(void);
+
+#endif
@@ -0,0 +1,60 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __TARGETS_INCLUDED__
+#define __TARGETS_INCLUDED__
+
+#include <typedefs.h>
+#include <config.h>
+#include <random.h>
+#include <alias.h>
+
+/* A --targets entry: 'hosts' addresses from 'first', on an alias table column
+   (see drawTarget()). 16 bytes: 4 entries per cache line. */
+typedef struct {
+  alias_t  column;
+  uint32_t first;                   /* first address (host order)       */
+  uint32_t hosts;                   /* addresses from 'first'           */
+} target_t;
+
+/* Entries of the file. Read only after loadTargets(). */
+extern target_t *targets;
+extern uint32_t  num_targets;
+
+/* Reads the --targets file and resolves its names (nothing without --targets). */
+extern int  loadTargets(const struct config_options * const __restrict__);
+extern void freeTargets(void);
+
+/* Draws a destination address (network order): An entry, by its weight, then
+   one of its hosts. Three random words at most, however many entries. */
+static inline in_addr_t drawTarget(void)
+{
+  const target_t *e;
+  uint32_t addr;
+
+  e = &targets[drawAlias(&targets->column, num_targets, sizeof(target_t))];
+
+  addr = e->first;
+  if (e->hosts > 1)
+    addr += ((uint64_t)__RANDOM() * e->hosts) >> 32;
+
+  return htonl(addr);
+}
+
+#endif
@@ -0,0 +1,41 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __TEMPLATE_INCLUDED__
+#define __TEMPLATE_INCLUDED__
+
+#include <typedefs.h>
+#include <config.h>
+#include <modules.h>
+
+/* Builds every module that will be used once, recording which bytes come from
+   RANDOM() and from the destination address. Modules whose templates don't
+   reproduce their output exactly keep being called for every packet. Each
+   stream has its own templates (see current_stream). */
+extern void compileTemplates(const struct config_options * const __restrict__);
+
+extern void freeTemplates(void);
+
+/* TRUE if module 'ptbl' packets are built from a template. */
+extern int hasTemplate(modules_table_t *);
+
+/* Builds the packet of module 'ptbl' on 'packet', from its template if there is one. */
+extern void buildPacket(modules_table_t *, const struct config_options * const __restrict__, size_t *);
+
+#endif
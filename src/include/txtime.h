@@ -0,0 +1,48 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __TXTIME_INCLUDED__
+#define __TXTIME_INCLUDED__
+
+#include <time.h>
+#include <sys/socket.h>
+#include <typedefs.h>
+#include <config.h>
+
+/* Space for the SCM_TXTIME control message of a packet. */
+#define TXTIME_CONTROL_SIZE CMSG_SPACE(sizeof(uint64_t))
+
+/* Clock of the transmit times, depending on the --txtime qdisc. */
+extern clockid_t txtimeClock(const struct config_options * const __restrict__);
+
+/* Sets SO_TXTIME on the socket and asks for transmit timestamps, to measure
+   the departures. */
+extern int  initTxtime(socket_t, const struct config_options * const __restrict__);
+
+/* Writes the SCM_TXTIME control message of a packet leaving at 'txtime' on
+   'control' (TXTIME_CONTROL_SIZE bytes) and remembers it, in sending order. */
+extern void setTxtime(struct msghdr *, void *control, uint64_t txtime);
+
+/* Counts the departures (and the packets dropped by the qdisc) reported by the
+   kernel. With 'wait', waits for the packets still queued. */
+extern void readDepartures(socket_t, int wait);
+
+extern void closeTxtime(void);
+
+#endif
@@ -0,0 +1,60 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __WORKER_INCLUDED__
+#define __WORKER_INCLUDED__
+
+#include <pthread.h>
+#include <typedefs.h>
+#include <config.h>
+#include <pacing.h>
+#include <stats.h>
+
+/* A worker's share of a --stream. */
+typedef struct {
+  struct config_options co;           /* private copy, with this worker's threshold  */
+  pacer_t     pacer;                  /* its --rate and --bitrate share               */
+  dest_iter_t dest;                   /* its destinations, in its --dest-order        */
+  size_t      mix;                    /* place on the --protocol-mix schedule         */
+  uint8_t     proto;                  /* its protocol (modules change co's)           */
+  int         done;                   /* its threshold reached                        */
+} worker_stream_t;
+
+/* Per thread state. Aligned to cache lines, so workers don't share them. */
+typedef struct {
+  pthread_t   thread;
+  unsigned    id;
+  int         cpu;                    /* CPU the worker is pinned to (-1: not pinned) */
+  int         status;                 /* TRUE if the worker finished without errors   */
+  pacer_t     pacer;                  /* --rate and --bitrate share                   */
+  dest_iter_t dest;                   /* destination addresses, in --dest-order       */
+  stats_t     stats;                  /* written by this worker only                  */
+  struct config_options co;           /* private copy: modules change it per packet   */
+  worker_stream_t *streams;           /* one per --stream (NULL without them)         */
+  unsigned    turn;                   /* next stream to fill the gaps (see streamLoop()) */
+} __attribute__((aligned(CACHE_LINE_SIZE))) worker_t;
+
+/* Splits the work between --threads workers and opens the first worker's
+   socket on the calling thread. */
+extern int initWorkers(const struct config_options * const __restrict__);
+
+/* Runs all workers (the first one on the calling thread) and waits for them. */
+extern int runWorkers(const struct cidr * const);
+
+#endif
@@ -0,0 +1,174 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <common.h>
+#include <ctype.h>
+
+/* NOTE: Protocol mix (--protocol-mix).
+
+   The order of the modules of --protocol T50 is a schedule, built once by
+   smooth weighted round-robin: On every slot each module gains its weight,
+   the one with the most credit is taken and loses the weights' total. A
+   module gets exactly its share of every cycle of the schedule, spread out as
+   evenly as the weights allow (UDP:3,TCP:1: UDP TCP UDP UDP, never three in a
+   row but on the cycle's ends). Workers just walk the schedule, so choosing
+   a module costs a load, whatever the weights. Without --protocol-mix every
+   module weighs 1: One packet of each, in the table order. */
+
+#define MAXIMUM_MIX_LENGTH 65536    /* slots on the schedule (after the gcd) */
+
+uint8_t  *mix_schedule = NULL;
+uint32_t  mix_length = 0;
+
+static int parseMix(const char *, uint32_t *, unsigned);
+
+int initMix(const struct config_options * const __restrict__ co)
+{
+  uint32_t *weights;
+  int64_t *credit, total;
+  unsigned modules, i, best;
+  uint32_t n, gcd, a, b;
+  int t50;
+
+  assert(co != NULL);
+
+  /* The streams share the schedule. */
+  for (i = 0, t50 = co->ip.protocol == IPPROTO_T50; i < num_streams; i++)
+    t50 |= streams[i].co.ip.protocol == IPPROTO_T50;
+
+  if (!t50)
+    return TRUE;
+
+  modules = getNumberOfRegisteredModules();
+
+  if ((weights = calloc(modules, sizeof(uint32_t))) == NULL ||
+      (credit = calloc(modules, sizeof(int64_t))) == NULL)
+  {
+    ERROR("Error allocating protocol mix");
+    free(weights);
+    return FALSE;
+  }
+
+  if (co->protocol_mix == NULL)
+    for (i = 0; i < modules; i++)
+      weights[i] = 1;
+  else if (!parseMix(co->protocol_mix, weights, modules))
+    goto error;
+
+  /* UDP:30,TCP:10 is UDP:3,TCP:1. */
+  for (i = gcd = 0; i < modules; i++)
+    for (a = weights[i]; a != 0; b = gcd % a, gcd = a, a = b)
+      ;
+
+  if (gcd == 0)
+  {
+    fprintf(stderr, "%s: no protocols on the protocol mix\n", PACKAGE);
+    goto error;
+  }
+
+  for (i = 0, total = 0; i < modules; i++)
+    total += (weights[i] /= gcd);
+
+  if (total > MAXIMUM_MIX_LENGTH)
+  {
+    fprintf(stderr, "%s: protocol mix weights add up to more than %d (after reducing them)\n",
+            PACKAGE, MAXIMUM_MIX_LENGTH);
+    goto error;
+  }
+
+  if ((mix_schedule = malloc(total)) == NULL)
+  {
+    ERROR("Error allocating protocol mix");
+    goto error;
+  }
+
+  for (n = 0; n < total; n++)
+  {
+    for (i = best = 0; i < modules; i++)
+      if ((credit[i] += weights[i]) > credit[best])
+        best = i;
+
+    credit[best] -= total;
+    mix_schedule[n] = best;
+  }
+
+  mix_length = total;
+
+  free(weights);
+  free(credit);
+  return TRUE;
+
+error:
+  free(weights);
+  free(credit);
+  return FALSE;
+}
+
+void freeMix(void)
+{
+  free(mix_schedule);
+  mix_schedule = NULL;
+  mix_length = 0;
+}
+
+/* Parses a list of PROTOCOL:WEIGHT entries. Modules not on the list aren't sent. */
+static int parseMix(const char *list, uint32_t *weights, unsigned modules)
+{
+  char *copy, *item, *save, *weight, *end;
+  unsigned long w;
+  unsigned i;
+  int status = TRUE;
+
+  if ((copy = strdup(list)) == NULL)
+  {
+    ERROR("Error allocating protocol mix");
+    return FALSE;
+  }
+
+  for (item = strtok_r(copy, ",", &save); item != NULL; item = strtok_r(NULL, ",", &save))
+  {
+    w = 1;
+    if ((weight = strchr(item, ':')) != NULL)
+    {
+      *weight++ = '\0';
+      w = strtoul(weight, &end, 10);
+      if (!isdigit(*weight) || *end != '\0' || w > MAXIMUM_MIX_LENGTH)
+        w = 0;
+    }
+
+    for (i = 0; i < modules; i++)
+      if (!strcasecmp(item, mod_table[i].acronym))
+        break;
+
+    if (i == modules || w == 0)
+    {
+      if (weight != NULL)
+        weight[-1] = ':';
+      fprintf(stderr, "%s: invalid protocol mix entry '%s' (PROTOCOL[:WEIGHT], weights from 1 to %d)\n",
+              PACKAGE, item, MAXIMUM_MIX_LENGTH);
+      status = FALSE;
+      break;
+    }
+
+    weights[i] += w;
+  }
+
+  free(copy);
+  return status;
+}
@@ -38,7 +38,8 @@ void icmp(const struct config_options * const __restrict__ co, size_t *size)
   greoptlen = gre_opt_len(co->gre.options, co->encapsulated);
   *size = sizeof(struct iphdr) +
                 greoptlen            +
-                sizeof(struct icmphdr);
+                sizeof(struct icmphdr) +
+                payload_size;
 
   /* Try to reallocate packet, if necessary */
   alloc_packet(*size);
@@ -49,7 +50,8 @@ void icmp(const struct config_options * const __restrict__ co, size_t *size)
   /* GRE Encapsulation takes place. */
   gre_encapsulation(packet, co,
         sizeof(struct iphdr) +
-        sizeof(struct icmphdr));
+        sizeof(struct icmphdr) +
+        payload_size);
 
   /* ICMP Header structure making a pointer to Packet. */
   icmp                   = (struct icmphdr *)((void *)ip + sizeof(struct iphdr) + greoptlen);
@@ -62,8 +64,10 @@ void icmp(const struct config_options * const __restrict__ co, size_t *size)
       icmp->un.gateway = INADDR_RND(co->icmp.gateway);
   icmp->checksum = 0;
 
+  putPayload((void *)icmp + sizeof(struct icmphdr));
+
   /* Computing the checksum. */
-  icmp->checksum = co->bogus_csum ? RANDOM() : cksum(icmp, sizeof(struct icmphdr));
+  icmp->checksum = co->bogus_csum ? RANDOM() : payloadCksum(icmp, sizeof(struct icmphdr), 0);
 
   /* GRE Encapsulation takes place. */
   gre_checksum(packet, co, *size);
@@ -57,6 +57,7 @@ void tcp(const struct config_options * const __restrict__ co, size_t *size)
           greoptlen             +
           sizeof(struct tcphdr) +
           tcpopt                +
+          payload_size          +
           sizeof(struct psdhdr);
 
   /* Try to reallocate packet, if necessary */
@@ -68,7 +69,8 @@ void tcp(const struct config_options * const __restrict__ co, size_t *size)
   gre_ip = gre_encapsulation(packet, co,
               sizeof(struct iphdr)  +
               sizeof(struct tcphdr) +
-              tcpopt);
+              tcpopt                +
+              payload_size);
 
   /*
    * The RFC 793 has defined a 4-bit field in the TCP header which encodes the size
@@ -424,18 +426,16 @@ void tcp(const struct config_options * const __restrict__ co, size_t *size)
 
   length = sizeof(struct tcphdr) + tcpolen;
 
-  /* Fill PSEUDO Header structure. */
-  pseudo           = (struct psdhdr *)buffer.ptr;
+  /* Fill PSEUDO Header structure, after the payload. */
+  pseudo           = (struct psdhdr *)putPayload(buffer.ptr);
   pseudo->saddr    = co->encapsulated ? gre_ip->saddr : ip->saddr;
   pseudo->daddr    = co->encapsulated ? gre_ip->daddr : ip->daddr;
   pseudo->zero     = 0;
   pseudo->protocol = co->ip.protocol;
-  pseudo->len      = htons(length);
-
-  length += sizeof(struct psdhdr);
+  pseudo->len      = htons(length + payload_size);
 
   /* Computing the checksum. */
-  tcp->check   = co->bogus_csum ? RANDOM() : cksum(tcp, length);
+  tcp->check   = co->bogus_csum ? RANDOM() : payloadCksum(tcp, length, sizeof(struct psdhdr));
 
   gre_checksum(packet, co, *size);
 }
@@ -40,7 +40,7 @@ void udp(const struct config_options * const __restrict__ co, size_t *size)
   assert(co != NULL);
 
   greoptlen = gre_opt_len(co->gre.options, co->encapsulated);
-  *size = sizeof(struct iphdr) + greoptlen + sizeof(struct udphdr) + sizeof(struct psdhdr);
+  *size = sizeof(struct iphdr) + greoptlen + sizeof(struct udphdr) + payload_size + sizeof(struct psdhdr);
 
   /* Try to reallocate packet, if necessary */
   alloc_packet(*size);
@@ -49,26 +49,26 @@ void udp(const struct config_options * const __restrict__ co, size_t *size)
   ip = ip_header(packet, *size, co);
 
   gre_ip = gre_encapsulation(packet, co,
-    sizeof(struct iphdr) + sizeof(struct udphdr));
+    sizeof(struct iphdr) + sizeof(struct udphdr) + payload_size);
 
   /* UDP Header structure making a pointer to  IP Header structure. */
   udp         = (struct udphdr *)((void *)ip + sizeof(struct iphdr) + greoptlen);
   udp->source = htons(IPPORT_RND(co->source));
   udp->dest   = htons(IPPORT_RND(co->dest));
-  udp->len    = htons(sizeof(struct udphdr));
+  udp->len    = htons(sizeof(struct udphdr) + payload_size);
   udp->check  = 0;    /* needed 'cause of cksum(), below! */
 
-  /* Fill PSEUDO Header structure. */
-  pseudo           = (struct psdhdr *)((void *)udp + sizeof(struct udphdr));
+  /* Fill PSEUDO Header structure, after the payload. */
+  pseudo           = (struct psdhdr *)putPayload((void *)udp + sizeof(struct udphdr));
   pseudo->saddr    = co->encapsulated ? gre_ip->saddr : ip->saddr;
   pseudo->daddr    = co->encapsulated ? gre_ip->daddr : ip->daddr;
   pseudo->zero     = 0;
   pseudo->protocol = co->ip.protocol;
-  pseudo->len      = htons(sizeof(struct udphdr));
+  pseudo->len      = htons(sizeof(struct udphdr) + payload_size);
 
   /* Computing the checksum. */
   udp->check  = co->bogus_csum ? RANDOM() :
-    cksum(udp, sizeof(struct udphdr) + sizeof(struct psdhdr));
+    payloadCksum(udp, sizeof(struct udphdr), sizeof(struct psdhdr));
 
   gre_checksum(packet, co, *size);
 }
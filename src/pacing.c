@@ -0,0 +1,211 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <common.h>
+#include <sched.h>
+#include <sys/prctl.h>
+
+/* NOTE: Rate control.
+
+   Each worker has token buckets for 1/N of --rate and --bitrate, kept as the
+   time they'll be full again (the "theoretical arrival time" of GCRA): A packet
+   may go when that time, less the time --burst packets take, has passed. Workers
+   don't share anything, so adding threads doesn't add locks.
+
+   Short waits are spent spinning on the clock (yielding the CPU, but for the
+   last few microseconds). Longer ones sleep, up to PACING_SPIN_NS before the
+   deadline, after sending the queued packets (with --batch they'd wait for the
+   batch to fill up, breaking the rate).
+
+   With --txtime, the qdisc does the waiting: Packets get their time on the
+   --txtime clock, PACING_TXTIME_LEAD_NS ahead, and the worker only sleeps to
+   keep that far ahead (there's no burst: packets leave evenly spaced). Late
+   wake ups don't delay the packets, unless they're later than the lead. */
+
+#define PACING_SPIN_NS  50000     /* spin on the last 50 us of a wait    */
+#define PACING_YIELD_NS 5000      /* yield the CPU until the last 5 us   */
+#define PACING_LATE_NS  1000000   /* lateness made up for (1 ms)         */
+#define PACING_TXTIME_LEAD_NS 2000000 /* packets sent ahead with --txtime */
+
+__thread uint64_t pacing_txtime = 0;
+
+static inline void cpuRelax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+static inline uint64_t clockNs(clockid_t clock)
+{
+  struct timespec ts;
+
+  clock_gettime(clock, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int waitUntil(pacer_t *, double, double);
+
+uint64_t pacingClock(void)
+{
+  return clockNs(CLOCK_MONOTONIC_RAW);
+}
+
+void initPacer(pacer_t *p, const struct config_options * const __restrict__ co, unsigned workers)
+{
+  assert(p != NULL);
+  assert(co != NULL);
+
+  memset(p, 0, sizeof(pacer_t));
+
+  if (co->rate == 0 && co->bitrate == 0 && co->replay_speed == 0)
+    return;
+
+  p->active = TRUE;
+  p->burst = co->burst ? co->burst : co->batch;
+  p->clock = CLOCK_MONOTONIC_RAW;
+
+  if (co->txtime)
+  {
+    p->txtime = TRUE;
+    p->burst = 1;
+    p->clock = txtimeClock(co);
+  }
+
+  if (co->rate)
+    p->packet_ns = 1e9 * workers / co->rate;
+  if (co->bitrate)
+    p->bit_ns = 1e9 * workers / co->bitrate;
+
+  /* Sleeps end on time, instead of up to 50 us late (the default timer slack). */
+  prctl(PR_SET_TIMERSLACK, 1UL, 0, 0, 0);
+
+  p->start = clockNs(p->clock);
+}
+
+int pace(pacer_t *p, size_t size)
+{
+  double now, t, cost;
+
+  now = clockNs(p->clock) - p->start;
+  cost = size * 8 * p->bit_ns;
+
+  /* The buckets start with a single packet, so the average rate is right from the start. */
+  if (!p->started)
+  {
+    p->started = TRUE;
+    p->packet_tat = now + (p->burst - 1) * p->packet_ns;
+    p->bit_tat = now + (p->burst - 1) * cost;
+  }
+
+  /* Full buckets don't get any fuller. Packets late by less than
+     PACING_LATE_NS (late wake ups, preemption) are made up for, though. */
+  if (p->packet_tat < now - PACING_LATE_NS)
+    p->packet_tat = now - PACING_LATE_NS;
+  if (p->bit_tat < now - PACING_LATE_NS)
+    p->bit_tat = now - PACING_LATE_NS;
+
+  /* When both buckets allow the packet. */
+  t = p->packet_tat - (p->burst - 1) * p->packet_ns;
+  if (t < p->bit_tat - (p->burst - 1) * cost)
+    t = p->bit_tat - (p->burst - 1) * cost;
+
+  p->packet_tat += p->packet_ns;
+  p->bit_tat += cost;
+
+  return waitUntil(p, t, now);
+}
+
+uint64_t pacerDue(const pacer_t *p)
+{
+  double t;
+
+  if (!p->started)
+    return p->start;
+
+  /* As pace(). The --burst of the bit bucket depends on the packet size: It's left out. */
+  t = p->packet_tat - (p->burst - 1) * p->packet_ns;
+  if (t < p->bit_tat)
+    t = p->bit_tat;
+
+  return (int64_t)p->start + (int64_t)t;
+}
+
+uint64_t pacerClock(const pacer_t *p)
+{
+  return clockNs(p->clock);
+}
+
+int paceAt(pacer_t *p, uint64_t t)
+{
+  return waitUntil(p, t, clockNs(p->clock) - p->start);
+}
+
+/* Waits until 't' ('now' being the current time). */
+static int waitUntil(pacer_t *p, double t, double now)
+{
+  struct timespec ts;
+  uint64_t ns;
+  double wait;
+
+  /* The qdisc holds the packet until its time. Sleeps only keep the worker
+     from getting further ahead. */
+  if (p->txtime)
+  {
+    pacing_txtime = p->start + (uint64_t)(PACING_TXTIME_LEAD_NS + t);
+
+    if ((wait = t - now) < PACING_SPIN_NS)
+      return TRUE;
+
+    if (!flushPackets())
+      return FALSE;
+
+    ns = wait;
+    ts.tv_sec = ns / 1000000000;
+    ts.tv_nsec = ns % 1000000000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, &ts) == EINTR)
+      ;
+
+    return TRUE;
+  }
+
+  if ((wait = t - now) <= 0)
+    return TRUE;
+
+  if (wait > PACING_SPIN_NS)
+  {
+    if (!flushPackets())
+      return FALSE;
+
+    ns = wait - PACING_SPIN_NS;
+    ts.tv_sec = ns / 1000000000;
+    ts.tv_nsec = ns % 1000000000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, &ts) == EINTR)
+      ;
+  }
+
+  /* Other threads may need this CPU, unless it's about time. */
+  while ((wait = t - (double)(clockNs(p->clock) - p->start)) > 0)
+    if (wait > PACING_YIELD_NS)
+      sched_yield();
+    else
+      cpuRelax();
+
+  return TRUE;
+}
@@ -0,0 +1,213 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <common.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* NOTE: Application payload.
+
+   The payload is the same on every packet: --payload-file is mapped once (only
+   --payload-size bytes of it, if given) and --payload-size alone is filled
+   with random bytes once. Modules copy it after their headers, so templates
+   and the pool hold it already and only the headers are patched per packet.
+   With --size, packets take as much of it as their size needs.
+
+   Its sums are calculated once too, for every even prefix. Checksums covering
+   it are the sum of the header, the payload prefix sum and the bytes after the
+   payload (the pseudo header). An odd payload is padded with a zero byte on the
+   sum only, as the receiver does: The packet has exactly its size. */
+
+const uint8_t  *payload_data = NULL;
+size_t          payload_length = 0;
+__thread size_t payload_size = 0;
+
+static uint16_t *payload_sums = NULL;   /* sums of the first 2*i bytes, not complemented */
+static void     *payload_map = NULL;
+static int       payload_mapped_file;
+
+static int sumPayload(void);
+
+int loadPayload(const struct config_options * const __restrict__ co)
+{
+  struct stat st;
+  uint8_t *p;
+  size_t i, size;
+  int fd;
+
+  assert(co != NULL);
+
+  if (co->payload_file != NULL)
+  {
+    if ((fd = open(co->payload_file, O_RDONLY)) == -1 || fstat(fd, &st) == -1)
+    {
+      fprintf(stderr, "%s: cannot open payload file '%s': %s\n",
+              PACKAGE, co->payload_file, strerror(errno));
+      if (fd != -1)
+        close(fd);
+      return FALSE;
+    }
+
+    size = co->payload_size ? co->payload_size : (size_t)st.st_size;
+    if (size == 0 || size > (size_t)st.st_size || size > MAXIMUM_PAYLOAD)
+    {
+      if (size == 0)
+        fprintf(stderr, "%s: payload file '%s' is empty\n", PACKAGE, co->payload_file);
+      else if (size > (size_t)st.st_size)
+        fprintf(stderr, "%s: payload file '%s' has only %lld bytes\n",
+                PACKAGE, co->payload_file, (long long)st.st_size);
+      else
+        fprintf(stderr, "%s: payload file '%s' is bigger than %d bytes (see --payload-size)\n",
+                PACKAGE, co->payload_file, MAXIMUM_PAYLOAD);
+      close(fd);
+      return FALSE;
+    }
+
+    payload_map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (payload_map == MAP_FAILED)
+    {
+      payload_map = NULL;
+      ERROR("Error mapping payload file");
+      return FALSE;
+    }
+
+    payload_mapped_file = TRUE;
+    payload_data = payload_map;
+  }
+  else if (co->payload_size)
+  {
+    size = co->payload_size;
+    if ((p = malloc(size)) == NULL)
+    {
+      ERROR("Error allocating payload");
+      return FALSE;
+    }
+
+    for (i = 0; i < size; i++)
+      p[i] = __RANDOM();
+
+    payload_mapped_file = FALSE;
+    payload_data = p;
+  }
+  else
+    return TRUE;
+
+  payload_length = size;
+  setPayloadSize(size);
+
+  return sumPayload();
+}
+
+int extendPayload(size_t length)
+{
+  uint8_t *p;
+  size_t i;
+
+  if (length <= payload_length)
+    return TRUE;
+
+  if ((p = malloc(length)) == NULL)
+  {
+    ERROR("Error allocating payload");
+    return FALSE;
+  }
+
+  /* NOTE: File contents are padded. Random payloads stay random. */
+  if (payload_length)
+    memcpy(p, payload_data, payload_length);
+  for (i = payload_length; i < length; i++)
+    p[i] = payload_mapped_file ? 0 : __RANDOM();
+
+  if (payload_map != NULL)
+    munmap(payload_map, payload_length);
+  else
+    free((void *)payload_data);
+
+  payload_map = NULL;
+  payload_data = p;
+  payload_length = length;
+  setPayloadSize(length);
+
+  return sumPayload();
+}
+
+void freePayload(void)
+{
+  if (payload_map != NULL)
+    munmap(payload_map, payload_length);
+  else
+    free((void *)payload_data);
+
+  free(payload_sums);
+
+  payload_map = NULL;
+  payload_data = NULL;
+  payload_sums = NULL;
+  payload_length = 0;
+  setPayloadSize(0);
+}
+
+/* Sums every even prefix of the payload, in host order (as cksum()). */
+static int sumPayload(void)
+{
+  uint32_t sum;
+  uint16_t word;
+  size_t i;
+
+  free(payload_sums);
+  if ((payload_sums = malloc((payload_length / 2 + 1) * sizeof(uint16_t))) == NULL)
+  {
+    ERROR("Error allocating payload");
+    return FALSE;
+  }
+
+  payload_sums[0] = sum = 0;
+  for (i = 1; i <= payload_length / 2; i++)
+  {
+    memcpy(&word, payload_data + 2 * (i - 1), sizeof(word));
+    sum += word;
+    payload_sums[i] = sum = (sum & 0xffff) + (sum >> 16);
+  }
+
+  return TRUE;
+}
+
+uint16_t payloadCksum(void *header, size_t length, size_t trailer)
+{
+  uint32_t sum;
+
+  if (payload_size == 0)
+    return cksum(header, length + trailer);
+
+  /* NOTE: Headers have even lengths, so the payload starts on an even offset.
+           A lone last byte is summed as the low byte of a word. */
+  sum = (uint16_t)~cksum(header, length) + payload_sums[payload_size / 2];
+  if (payload_size & 1)
+    sum += payload_data[payload_size - 1];
+
+  if (trailer)
+    sum += (uint16_t)~cksum(header + length + payload_size, trailer);
+
+  sum = (sum & 0xffff) + (sum >> 16);
+  sum = (sum & 0xffff) + (sum >> 16);
+
+  return ~sum;
+}
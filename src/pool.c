@@ -0,0 +1,136 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <common.h>
+
+/* NOTE: Packet pool.
+
+   With --pool K, K packets per protocol are built before the workers start,
+   one after the other on a single buffer (the arena), in the order they would
+   be sent (with --protocol T50, whole cycles of the --protocol-mix schedule).
+   Workers just cycle through them, each one starting at its own place, so
+   nothing is built while sending. Every backend copies the packet it sends,
+   so the arena is shared by all workers and never written again. */
+
+/* Packets start on 8 bytes boundaries. */
+#define POOL_ALIGN(x) (((x) + 7) & ~(size_t)7)
+
+void         *pool_arena = NULL;
+pool_entry_t *pool_entries = NULL;
+size_t        pool_count = 0;
+
+int buildPool(const struct config_options * const __restrict__ co, const struct cidr * const cidr)
+{
+  struct config_options tmp;
+  struct timespec t0, t1;
+  modules_table_t *ptbl;
+  dest_iter_t dest;
+  size_t arena_size, used, count, n, size;
+  void *p;
+
+  assert(co != NULL);
+  assert(cidr != NULL);
+
+  if (co->pool == 0)
+    return TRUE;
+
+  count = co->pool;
+  if (co->ip.protocol == IPPROTO_T50)
+  {
+    count *= getNumberOfRegisteredModules();
+    count += (mix_length - count % mix_length) % mix_length;
+  }
+
+  if ((pool_entries = malloc(count * sizeof(pool_entry_t))) == NULL)
+  {
+    ERROR("Error allocating packet pool");
+    return FALSE;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+
+  /* NOTE: Modules get a copy, since their options are changed here. */
+  tmp = *co;
+
+  ptbl = mod_table;
+  if (co->ip.protocol != IPPROTO_T50)
+    ptbl += co->ip.protoname;
+
+  alloc_packet(INITIAL_PACKET_SIZE);
+  initDestinations(&dest, cidr, co->dest_order, co->dest_shards, 0, 1);
+
+  arena_size = used = 0;
+  for (n = 0; n < count; n++)
+  {
+    if (co->ip.protocol == IPPROTO_T50)
+      ptbl = mod_table + mix_schedule[n % mix_length];
+
+    /* Same destination address choice as the workers. */
+    tmp.ip.daddr = nextDestination(&dest);
+
+    tmp.ip.protocol = ptbl->protocol_id;
+    buildPacket(ptbl, &tmp, &size);
+
+    /* The arena grows as needed. Packets are placed by offset, so it can move. */
+    if (used + size > arena_size)
+    {
+      arena_size = POOL_ALIGN((used + size) * 2);
+      if (arena_size > UINT32_MAX || (p = realloc(pool_arena, arena_size)) == NULL)
+      {
+        ERROR("Error allocating packet pool");
+        freePool();
+        return FALSE;
+      }
+      pool_arena = p;
+    }
+
+    memcpy(pool_arena + used, packet, size);
+    pool_entries[n].offset = used;
+    pool_entries[n].size   = size;
+    pool_entries[n].daddr  = tmp.ip.daddr;
+    pool_entries[n].module = ptbl - mod_table;
+    used = POOL_ALIGN(used + size);
+  }
+
+  /* Gives back what the last growth didn't use. */
+  if ((p = realloc(pool_arena, used)) != NULL)
+    pool_arena = p;
+
+  pool_count = count;
+
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+
+  printf("%s: pool of %zu packets (%zu kB) generated in %.1f ms\n",
+    PACKAGE,
+    count,
+    (used + count * sizeof(pool_entry_t) + 1023) / 1024,
+    (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6);
+
+  return TRUE;
+}
+
+void freePool(void)
+{
+  free(pool_arena);
+  free(pool_entries);
+
+  pool_arena = NULL;
+  pool_entries = NULL;
+  pool_count = 0;
+}
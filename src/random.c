@@ -0,0 +1,211 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <common.h>
+
+/* NOTE: Random numbers.
+
+   RANDOM() takes words from a per thread ring, filled RANDOM_RING_SIZE words
+   at a time by the selected generator, so drawing a header field costs a load
+   and an increment. Generators keep per thread state, seeded on the first fill
+   from the global seed and a thread counter (through splitmix64), so no two
+   threads share a sequence and there are no locks. */
+
+/* Independent xoshiro256** generators run side by side. They're laid out as
+   arrays (one per state word), so the compiler generates vector code for them. */
+#define XOSHIRO_LANES 8
+
+__thread uint32_t random_ring[RANDOM_RING_SIZE];
+__thread unsigned random_next = RANDOM_RING_SIZE;   /* empty */
+
+static rng_table_t *rng = NULL;
+static uint64_t seed;
+static unsigned threads_seeded = 0;
+
+static __thread int seeded = FALSE;
+
+static __thread uint64_t xoshiro_state[4][XOSHIRO_LANES] __attribute__((aligned(64)));
+static __thread uint64_t pcg_state, pcg_inc;
+
+static void xoshiro_seed(uint64_t *);
+static void xoshiro_fill(uint32_t *, size_t);
+static void pcg_seed(uint64_t *);
+static void pcg_fill(uint32_t *, size_t);
+#if defined(__x86_64__) || defined(__i386__)
+static int  rdrand_available(void);
+static void rdrand_fill(uint32_t *, size_t);
+#endif
+static void libc_fill(uint32_t *, size_t);
+
+rng_table_t rng_table[] = {
+  { "xoshiro", "xoshiro256**, 8 generators per thread, vectorized", NULL,             xoshiro_fill },
+  { "pcg",     "PCG32 (XSH RR), one generator per thread",          NULL,             pcg_fill     },
+#if defined(__x86_64__) || defined(__i386__)
+  { "rdrand",  "CPU hardware generator (RDRAND instruction)",       rdrand_available, rdrand_fill  },
+#endif
+  { "libc",    "C library random() (locks on every call)",          NULL,             libc_fill    },
+  { NULL,      NULL,                                                NULL,             NULL         }
+};
+
+/* splitmix64: Used only to expand the seeds. */
+static uint64_t splitmix64(uint64_t *x)
+{
+  uint64_t z;
+
+  z = (*x += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+void initRandom(const struct config_options * const __restrict__ co)
+{
+  struct timespec ts;
+
+  assert(co != NULL);
+
+  rng = &rng_table[co->rng];
+
+  /* NOTE: Random seed don't need to be so precise! */
+  clock_gettime(CLOCK_REALTIME, &ts);
+  seed = ((uint64_t)ts.tv_sec << 32) ^ ts.tv_nsec ^ ((uint64_t)getpid() << 16);
+
+  srandom(seed);
+}
+
+uint32_t refillRandom(void)
+{
+  uint64_t x;
+
+  if (!seeded)
+  {
+    assert(rng != NULL);
+
+    x = seed + __sync_fetch_and_add(&threads_seeded, 1) * 0x632be59bd9b4e019ULL;
+
+    xoshiro_seed(&x);
+    pcg_seed(&x);
+    seeded = TRUE;
+  }
+
+  rng->fill(random_ring, RANDOM_RING_SIZE);
+  random_next = 1;
+
+  return random_ring[0];
+}
+
+static inline uint64_t rotl(uint64_t x, int k)
+{
+  return (x << k) | (x >> (64 - k));
+}
+
+static void xoshiro_seed(uint64_t *x)
+{
+  unsigned i, j;
+
+  for (i = 0; i < 4; i++)
+    for (j = 0; j < XOSHIRO_LANES; j++)
+      xoshiro_state[i][j] = splitmix64(x);
+}
+
+/* Two words per generator, per step. The clones are selected by CPUID on
+   startup (the default build targets SSE2 only). */
+__attribute__((target_clones("avx512f", "avx2", "default")))
+static void xoshiro_fill(uint32_t *ring, size_t count)
+{
+  uint64_t *s0 = xoshiro_state[0], *s1 = xoshiro_state[1],
+           *s2 = xoshiro_state[2], *s3 = xoshiro_state[3];
+  uint64_t out[XOSHIRO_LANES], t;
+  size_t n;
+  unsigned i;
+
+  for (n = 0; n < count; n += 2 * XOSHIRO_LANES)
+  {
+    for (i = 0; i < XOSHIRO_LANES; i++)
+    {
+      out[i] = rotl(s1[i] * 5, 7) * 9;
+
+      t = s1[i] << 17;
+      s2[i] ^= s0[i];
+      s3[i] ^= s1[i];
+      s1[i] ^= s2[i];
+      s0[i] ^= s3[i];
+      s2[i] ^= t;
+      s3[i] = rotl(s3[i], 45);
+    }
+
+    memcpy(ring + n, out, sizeof(out));
+  }
+}
+
+static void pcg_seed(uint64_t *x)
+{
+  pcg_state = splitmix64(x);
+  pcg_inc = splitmix64(x) | 1;
+}
+
+static void pcg_fill(uint32_t *ring, size_t count)
+{
+  uint64_t state = pcg_state;
+  uint32_t xorshifted, rot;
+  size_t n;
+
+  for (n = 0; n < count; n++)
+  {
+    xorshifted = ((state >> 18) ^ state) >> 27;
+    rot = state >> 59;
+    ring[n] = (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+    state = state * 6364136223846793005ULL + pcg_inc;
+  }
+
+  pcg_state = state;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+static int rdrand_available(void)
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("rdrnd");
+}
+
+__attribute__((target("rdrnd")))
+static void rdrand_fill(uint32_t *ring, size_t count)
+{
+  unsigned int v;
+  size_t n;
+
+  /* NOTE: RDRAND fails only when the hardware is exhausted. It will work eventually. */
+  for (n = 0; n < count; n++)
+  {
+    while (!_rdrand32_step(&v))
+      ;
+    ring[n] = v;
+  }
+}
+#endif
+
+static void libc_fill(uint32_t *ring, size_t count)
+{
+  size_t n;
+
+  for (n = 0; n < count; n++)
+    ring[n] = random();
+}
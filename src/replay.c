@@ -0,0 +1,339 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <common.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* NOTE: pcap replay (--replay).
+
+   The file is mapped and its IPv4 packets are indexed once: Where each one
+   starts, after the link layer header, its size and time. Workers send them
+   straight from the mapping, so nothing is built or copied here (backends
+   copy what they send anyway). With a target, the destination address is
+   chosen as for built packets and the packet is copied to the worker's
+   buffer, where the IP and TCP/UDP checksums are updated for the new address
+   (RFC 1624, see updateCksum()).
+
+   Classic pcap files, with micro or nanosecond timestamps and either byte
+   order, from Ethernet (with or without a VLAN tag), Linux cooked (SLL) or raw
+   IP captures. Fragments keep their checksums, since only the first one has
+   the TCP/UDP header. */
+
+#define PCAP_MAGIC_USEC     0xa1b2c3d4
+#define PCAP_MAGIC_NSEC     0xa1b23c4d
+
+#define LINKTYPE_ETHERNET   1
+#define LINKTYPE_RAW        101
+#define LINKTYPE_LINUX_SLL  113
+#define LINKTYPE_IPV4       228
+
+#define ETHERTYPE_IPV4      0x0800
+#define ETHERTYPE_VLAN      0x8100
+
+struct replay_file_header {
+  uint32_t magic;
+  uint16_t version_major;
+  uint16_t version_minor;
+  int32_t  thiszone;
+  uint32_t sigfigs;
+  uint32_t snaplen;
+  uint32_t linktype;
+};
+
+struct replay_record {
+  uint32_t ts_sec;
+  uint32_t ts_frac;                 /* micro or nanoseconds */
+  uint32_t caplen;
+  uint32_t len;
+};
+
+const uint8_t  *replay_data = NULL;
+replay_entry_t *replay_entries = NULL;
+size_t          replay_count = 0;
+uint64_t        replay_period = 0;
+int             replay_rewrite = FALSE;
+
+static size_t replay_size;
+
+static uint32_t swap32(uint32_t x, int swapped)
+{
+  return swapped ? __builtin_bswap32(x) : x;
+}
+
+/* Offset of the IPv4 header on a 'caplen' bytes frame, or -1 if it isn't IPv4. */
+static long ipOffset(const uint8_t *frame, uint32_t caplen, uint32_t linktype)
+{
+  uint16_t type;
+  long offset;
+
+  switch (linktype)
+  {
+    case LINKTYPE_RAW:
+    case LINKTYPE_IPV4:
+      return caplen ? 0 : -1;
+
+    case LINKTYPE_LINUX_SLL:
+      if (caplen < 16)
+        return -1;
+      type = (frame[14] << 8) | frame[15];
+      offset = 16;
+      break;
+
+    default:                        /* LINKTYPE_ETHERNET */
+      if (caplen < 14)
+        return -1;
+      type = (frame[12] << 8) | frame[13];
+      offset = 14;
+
+      if (type == ETHERTYPE_VLAN && caplen >= 18)
+      {
+        type = (frame[16] << 8) | frame[17];
+        offset = 18;
+      }
+  }
+
+  return type == ETHERTYPE_IPV4 ? offset : -1;
+}
+
+/* Fills 'e' from the IP packet at 'ip', 'avail' bytes captured. */
+static int indexPacket(replay_entry_t *e, const uint8_t *ip, uint32_t avail)
+{
+  const struct iphdr *iph = (const struct iphdr *)ip;
+  modules_table_t *ptbl;
+  unsigned ihl, size;
+
+  if (avail < sizeof(struct iphdr) || iph->version != 4)
+    return FALSE;
+
+  ihl = iph->ihl * 4;
+  size = ntohs(iph->tot_len);
+
+  /* NOTE: Truncated packets (--snaplen) can't be sent as they were. */
+  if (ihl < sizeof(struct iphdr) || size < ihl || size > avail)
+    return FALSE;
+
+  e->offset = ip - replay_data;
+  e->size = size;
+  e->daddr = iph->daddr;
+  e->l4_check = 0;
+  e->udp = FALSE;
+
+  /* Not a fragment (MF flag and offset clear). */
+  if (!(iph->frag_off & htons(0x3fff)))
+  {
+    if (iph->protocol == IPPROTO_TCP && size >= ihl + sizeof(struct tcphdr))
+      e->l4_check = ihl + offsetof(struct tcphdr, check);
+    else if (iph->protocol == IPPROTO_UDP && size >= ihl + sizeof(struct udphdr))
+    {
+      e->l4_check = ihl + offsetof(struct udphdr, check);
+      e->udp = TRUE;
+    }
+  }
+
+  /* Counted as the first module of the protocol. */
+  e->module = STATS_MODULES;
+  for (ptbl = mod_table; ptbl->func != NULL; ptbl++)
+    if (ptbl->protocol_id == iph->protocol)
+    {
+      e->module = ptbl - mod_table;
+      break;
+    }
+
+  return TRUE;
+}
+
+int loadReplay(const struct config_options * const __restrict__ co)
+{
+  const struct replay_file_header *fh;
+  const struct replay_record *r;
+  replay_entry_t *p;
+  struct stat st;
+  uint64_t ts, first, frac_ns;
+  size_t offset, allocated, skipped;
+  uint32_t caplen, linktype;
+  long ip;
+  int fd, swapped;
+
+  assert(co != NULL);
+
+  if (co->replay == NULL)
+    return TRUE;
+
+  if ((fd = open(co->replay, O_RDONLY)) == -1 || fstat(fd, &st) == -1)
+  {
+    fprintf(stderr, "%s: cannot open replay file '%s': %s\n",
+            PACKAGE, co->replay, strerror(errno));
+    if (fd != -1)
+      close(fd);
+    return FALSE;
+  }
+
+  if ((size_t)st.st_size < sizeof(struct replay_file_header))
+  {
+    fprintf(stderr, "%s: replay file '%s' isn't a pcap file\n", PACKAGE, co->replay);
+    close(fd);
+    return FALSE;
+  }
+
+  replay_size = st.st_size;
+  replay_data = mmap(NULL, replay_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (replay_data == MAP_FAILED)
+  {
+    replay_data = NULL;
+    ERROR("Error mapping replay file");
+    return FALSE;
+  }
+
+  /* Indexed and sent in order.
+     NOTE: madvise() advices are values, not flags. One call each. */
+  madvise((void *)replay_data, replay_size, MADV_SEQUENTIAL);
+  madvise((void *)replay_data, replay_size, MADV_WILLNEED);
+
+  fh = (const struct replay_file_header *)replay_data;
+  swapped = fh->magic == __builtin_bswap32(PCAP_MAGIC_USEC) ||
+            fh->magic == __builtin_bswap32(PCAP_MAGIC_NSEC);
+  frac_ns = swap32(fh->magic, swapped) == PCAP_MAGIC_NSEC ? 1 : 1000;
+  linktype = swap32(fh->linktype, swapped);
+
+  if (swap32(fh->magic, swapped) != PCAP_MAGIC_USEC && swap32(fh->magic, swapped) != PCAP_MAGIC_NSEC)
+  {
+    fprintf(stderr, "%s: replay file '%s' isn't a pcap file\n", PACKAGE, co->replay);
+    freeReplay();
+    return FALSE;
+  }
+
+  if (linktype != LINKTYPE_ETHERNET && linktype != LINKTYPE_RAW &&
+      linktype != LINKTYPE_LINUX_SLL && linktype != LINKTYPE_IPV4)
+  {
+    fprintf(stderr, "%s: replay file '%s' has an unsupported link type (%u)\n",
+            PACKAGE, co->replay, linktype);
+    freeReplay();
+    return FALSE;
+  }
+
+  first = 0;
+  allocated = skipped = 0;
+  for (offset = sizeof(struct replay_file_header);
+       offset + sizeof(struct replay_record) <= replay_size;
+       offset += sizeof(struct replay_record) + caplen)
+  {
+    r = (const struct replay_record *)(replay_data + offset);
+    caplen = swap32(r->caplen, swapped);
+
+    /* NOTE: A capture cut short ends with a partial record. */
+    if (caplen > replay_size - offset - sizeof(struct replay_record))
+      break;
+
+    if (replay_count == allocated)
+    {
+      allocated = allocated ? allocated * 2 : 1024;
+      if ((p = realloc(replay_entries, allocated * sizeof(replay_entry_t))) == NULL)
+      {
+        ERROR("Error allocating replay index");
+        freeReplay();
+        return FALSE;
+      }
+      replay_entries = p;
+    }
+
+    ip = ipOffset((const uint8_t *)(r + 1), caplen, linktype);
+    if (ip < 0 || !indexPacket(&replay_entries[replay_count], (const uint8_t *)(r + 1) + ip, caplen - ip))
+    {
+      skipped++;
+      continue;
+    }
+
+    ts = swap32(r->ts_sec, swapped) * 1000000000ULL + swap32(r->ts_frac, swapped) * frac_ns;
+    if (replay_count == 0)
+      first = ts;
+
+    /* Out of order timestamps go at once. */
+    replay_entries[replay_count].time = ts > first && co->replay_speed ?
+      (ts - first) / co->replay_speed : 0;
+    replay_count++;
+  }
+
+  if (replay_count == 0)
+  {
+    fprintf(stderr, "%s: replay file '%s' has no IPv4 packets\n", PACKAGE, co->replay);
+    freeReplay();
+    return FALSE;
+  }
+
+  /* Gives back what the last growth didn't use. */
+  if ((p = realloc(replay_entries, replay_count * sizeof(replay_entry_t))) != NULL)
+    replay_entries = p;
+
+  /* Passes through the file are as far apart as its packets, on average. */
+  replay_period = replay_entries[replay_count - 1].time;
+  if (replay_count > 1)
+    replay_period += replay_period / (replay_count - 1);
+
+  replay_rewrite = co->ip.daddr != INADDR_ANY || co->targets != NULL;
+
+  printf("%s: replaying %zu packets from '%s' (%zu skipped, not IPv4 or truncated)\n",
+         PACKAGE, replay_count, co->replay, skipped);
+
+  return TRUE;
+}
+
+void freeReplay(void)
+{
+  if (replay_data != NULL)
+    munmap((void *)replay_data, replay_size);
+  free(replay_entries);
+
+  replay_data = NULL;
+  replay_entries = NULL;
+  replay_count = 0;
+}
+
+void rewritePacket(const replay_entry_t *e, in_addr_t daddr)
+{
+  struct iphdr *ip;
+  uint16_t *check;
+  uint32_t delta;
+
+  alloc_packet(e->size);
+  memcpy(packet, replay_data + e->offset, e->size);
+
+  ip = packet;
+  delta = cksumDelta(&ip->daddr, &daddr, sizeof(in_addr_t), FALSE);
+  ip->daddr = daddr;
+
+  /* NOTE: A zero IP checksum is left for the kernel to fill in (as on the packets built here). */
+  if (ip->check)
+    ip->check = updateCksum(ip->check, delta);
+
+  /* The pseudo header has the destination address too. */
+  if (e->l4_check)
+  {
+    check = packet + e->l4_check;
+    if (e->udp && *check == 0)
+      return;
+
+    *check = updateCksum(*check, delta);
+    if (e->udp && *check == 0)
+      *check = 0xffff;
+  }
+}
@@ -0,0 +1,244 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <common.h>
+#include <ctype.h>
+
+/* NOTE: Packet sizes (--sizes).
+
+   A list of sizes, or ranges of sizes, each one with a weight, or an IMIX
+   profile. Entries are drawn from an alias table (see alias.c): A column
+   picked at random, then either its own entry or its alias, by a second random
+   word. So drawing a size takes two or three random words, however many
+   entries there are. Sizes are of the whole IP packet, as sent: Modules
+   carrying the payload take as much of it as the size needs (none when their
+   headers are bigger already). The other modules keep their sizes. Each
+   stream has its own table (see current_stream). */
+
+#define MAXIMUM_SIZES 64            /* entries on the list              */
+#define MINIMUM_SIZE  20            /* an IP header                     */
+
+typedef struct {
+  alias_t  column;
+  uint32_t min, max;                /* sizes of the entry               */
+} size_entry_t;
+
+/* IMIX profiles, as IP packet sizes and weights. */
+static const struct {
+  char *name;
+  char *sizes;
+} size_profiles[] = {
+  { "imix",       "40:7,576:4,1500:1"         },    /* simple IMIX                       */
+  { "imix-tolly", "46:55,60:5,558:17,1500:23" },    /* 64, 78, 576 and 1518 bytes frames */
+  { NULL,         NULL                        }
+};
+
+/* A --sizes list. */
+typedef struct {
+  size_entry_t *sizes;
+  unsigned  num_sizes;
+  size_t   *headers;                /* per module; 0: no payload        */
+} size_table_t;
+
+static size_table_t tables[MAXIMUM_STREAMS];
+
+static int  initTable(size_table_t *, const struct config_options * const __restrict__);
+static int  parseSizes(size_table_t *, const char *, double *);
+
+int initSizes(const struct config_options * const __restrict__ co)
+{
+  unsigned i;
+
+  assert(co != NULL);
+
+  /* Without streams, the command line options have the first table. */
+  for (i = 0; i < (num_streams ? num_streams : 1); i++)
+    if (!initTable(&tables[i], num_streams ? &streams[i].co : co))
+    {
+      if (num_streams)
+        fprintf(stderr, "%s: on stream '%s'\n", PACKAGE, streams[i].args);
+      freeSizes();
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+void freeSizes(void)
+{
+  unsigned i;
+
+  for (i = 0; i < MAXIMUM_STREAMS; i++)
+  {
+    free(tables[i].sizes);
+    free(tables[i].headers);
+    tables[i].sizes = NULL;
+    tables[i].headers = NULL;
+    tables[i].num_sizes = 0;
+  }
+}
+
+int hasSizes(modules_table_t *ptbl)
+{
+  const size_table_t *t = &tables[current_stream];
+
+  return t->headers != NULL && t->headers[ptbl - mod_table] != 0;
+}
+
+void drawSize(modules_table_t *ptbl)
+{
+  const size_table_t *t = &tables[current_stream];
+  const size_entry_t *e;
+  size_t header, size;
+
+  if (t->headers == NULL || (header = t->headers[ptbl - mod_table]) == 0)
+    return;
+
+  /* NOTE: __RANDOM(), not RANDOM(): The size isn't a header field. */
+  e = &t->sizes[drawAlias(&t->sizes->column, t->num_sizes, sizeof(size_entry_t))];
+
+  /* NOTE: Multiply-high instead of a division, as in cidr.c. */
+  size = e->min;
+  if (e->max > e->min)
+    size += ((uint64_t)__RANDOM() * (e->max - e->min + 1)) >> 32;
+
+  setPayloadSize(size > header ? size - header : 0);
+}
+
+/* Builds table 't' from the --sizes of 'co' (none without it). */
+static int initTable(size_table_t *t, const struct config_options * const __restrict__ co)
+{
+  struct config_options tmp;
+  modules_table_t *ptbl;
+  double weights[MAXIMUM_SIZES];
+  size_t empty, full, longest;
+  unsigned i, sized;
+
+  if (co->sizes == NULL)
+    return TRUE;
+
+  if ((t->sizes = malloc(MAXIMUM_SIZES * sizeof(size_entry_t))) == NULL ||
+      (t->headers = calloc(getNumberOfRegisteredModules(), sizeof(size_t))) == NULL)
+  {
+    ERROR("Error allocating packet sizes");
+    return FALSE;
+  }
+
+  if (!parseSizes(t, co->sizes, weights))
+    return FALSE;
+
+  if (!buildAliasTable(&t->sizes->column, t->num_sizes, sizeof(size_entry_t), weights))
+    return FALSE;
+
+  for (i = 0, longest = 0; i < t->num_sizes; i++)
+    if (t->sizes[i].max > longest)
+      longest = t->sizes[i].max;
+
+  if (!extendPayload(longest))
+    return FALSE;
+
+  /* Modules whose packets grow with the payload carry it. */
+  tmp = *co;
+
+  for (i = sized = 0, ptbl = mod_table; ptbl->func != NULL; ptbl++, i++)
+    if (co->ip.protocol == IPPROTO_T50 || (int)i == (int)co->ip.protoname)
+    {
+      tmp.ip.protocol = ptbl->protocol_id;
+
+      setPayloadSize(0);
+      ptbl->func(&tmp, &empty);
+      setPayloadSize(2);
+      ptbl->func(&tmp, &full);
+
+      if (full != empty)
+      {
+        t->headers[i] = empty;
+        sized++;
+      }
+    }
+
+  setPayloadSize(payload_length);
+
+  if (!sized)
+  {
+    fprintf(stderr, "%s: --sizes needs ICMP, UDP or TCP packets\n", PACKAGE);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* Parses a list of SIZE[-SIZE][:WEIGHT] entries, or a profile name. */
+static int parseSizes(size_table_t *t, const char *list, double *weights)
+{
+  char *copy, *item, *save, *end;
+  unsigned long min, max;
+  unsigned i;
+
+  for (i = 0; size_profiles[i].name != NULL; i++)
+    if (!strcasecmp(list, size_profiles[i].name))
+      list = size_profiles[i].sizes;
+
+  if ((copy = strdup(list)) == NULL)
+  {
+    ERROR("Error allocating packet sizes");
+    return FALSE;
+  }
+
+  for (item = strtok_r(copy, ",", &save); item != NULL; item = strtok_r(NULL, ",", &save))
+  {
+    if (t->num_sizes == MAXIMUM_SIZES)
+    {
+      fprintf(stderr, "%s: too many packet sizes (up to %d)\n", PACKAGE, MAXIMUM_SIZES);
+      free(copy);
+      return FALSE;
+    }
+
+    min = max = strtoul(item, &end, 10);
+    if (end != item && *end == '-')
+      max = strtoul(end + 1, &end, 10);
+
+    weights[t->num_sizes] = 1.0;
+    if (*end == ':')
+      weights[t->num_sizes] = strtod(end + 1, &end);
+
+    if (!isdigit(*item) || *end != '\0' || min < MINIMUM_SIZE || max < min ||
+        max > MAXIMUM_PAYLOAD || !(weights[t->num_sizes] > 0))
+    {
+      fprintf(stderr, "%s: invalid packet size '%s' (SIZE[-SIZE][:WEIGHT], sizes from %d to %d)\n",
+              PACKAGE, item, MINIMUM_SIZE, MAXIMUM_PAYLOAD);
+      free(copy);
+      return FALSE;
+    }
+
+    t->sizes[t->num_sizes].min = min;
+    t->sizes[t->num_sizes].max = max;
+    t->num_sizes++;
+  }
+
+  free(copy);
+
+  if (t->num_sizes == 0)
+  {
+    fprintf(stderr, "%s: no packet sizes on '%s'\n", PACKAGE, list);
+    return FALSE;
+  }
+
+  return TRUE;
+}
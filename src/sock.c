@@ -19,40 +19,123 @@
 
 #include <common.h>
 
-/* Maximum number of tries to send the packet. */
-#define MAX_SENDTO_TRIES  100
-
 /* Initialized for error condition, just in case! */
-static socket_t fd = -1;
+static __thread socket_t fd = -1;
+
+/* Batch of packets waiting for sendmmsg(). Each queued packet is copied to
+   its own slot of 'batch_buffer', because modules reuse the packet buffer. */
+static __thread struct mmsghdr *batch_msgs = NULL;
+static __thread struct iovec *batch_iovs = NULL;
+static __thread struct sockaddr_in *batch_addrs = NULL;
+static __thread void *batch_buffer = NULL;
+static __thread size_t batch_slot_size = 0;
+static __thread unsigned batch_size = 1;
+static __thread unsigned batch_count = 0;
+static __thread char *batch_control = NULL;   /* SCM_TXTIME of each slot */
+
+/* --txtime: Packets carry their departure time. The transmit timestamps are
+   read every TXTIME_READ_PACKETS packets. */
+#define TXTIME_READ_PACKETS 64
+static __thread int txtime = FALSE;
+static __thread unsigned txtime_unread = 0;
+
+/* Selected output backend. */
+static __thread backends_table_t *backend = NULL;
+
+static int allocBatch(unsigned, size_t);
+static int sendTxtime(const void * const, size_t, struct sockaddr_in *);
+
+/* Opens the backend selected with --backend. */
+int createSocket(const struct config_options * const __restrict__ co)
+{
+  assert(co != NULL);
+
+  backend = &backend_table[co->backend];
+  return backend->open(co);
+}
+
+void closeSocket(void)
+{
+  if (backend != NULL)
+    backend->close();
+}
+
+int sendPacket(const void * const buffer, size_t size, const struct config_options * const __restrict__ co)
+{
+  return backend->send(buffer, size, co);
+}
+
+int flushPackets(void)
+{
+  return backend->flush();
+}
+
+/* Lets the backend choose where the next packet is built, avoiding a copy on sendPacket(). */
+int preparePacket(void)
+{
+  void *p;
+  size_t size;
+
+  if (backend->buffer == NULL)
+    return TRUE;
+
+  if ((p = backend->buffer(&size)) == NULL)
+    return FALSE;
+
+  set_packet_buffer(p, size);
+  return TRUE;
+}
 
 /* Socket configuration */
-int createSocket(void)
+int raw_open(const struct config_options * const __restrict__ co)
+{
+  if ((fd = openRawSocket()) == -1)
+    return FALSE;
+
+  txtime = co->txtime != TXTIME_OFF;
+  if (txtime)
+    if (!initTxtime(fd, co))
+      return FALSE;
+
+  /* Preallocate the sendmmsg() batch, if needed. */
+  batch_size = co->batch;
+  if (batch_size > 1)
+    if (!allocBatch(batch_size, INITIAL_PACKET_SIZE))
+      return FALSE;
+
+  return TRUE;
+}
+
+/* Creates and configures a raw IP socket. Also used by other backends.
+   Returns -1 on error. */
+socket_t openRawSocket(void)
 {
 	socklen_t len;
 	unsigned n = 1, *nptr = &n;
+	socket_t sock;
 
 	/* Setting SOCKET RAW. */
-	if( (fd = socket(AF_INET, SOCK_RAW, IPPROTO_RAW)) == -1 )
+	if( (sock = socket(AF_INET, SOCK_RAW, IPPROTO_RAW)) == -1 )
 	{
 		perror("error opening raw socket");
-		return FALSE;
+		return -1;
 	}
 
 	/* Setting IP_HDRINCL. */
-	if( setsockopt(fd, IPPROTO_IP, IP_HDRINCL, nptr, sizeof(n)) == -1 )
+	if( setsockopt(sock, IPPROTO_IP, IP_HDRINCL, nptr, sizeof(n)) == -1 )
 	{
 		perror("error setting socket options");
-		return FALSE;
+		goto error;
 	}
 
 /* Taken from libdnet by Dug Song. */
 #ifdef SO_SNDBUF
 	len = sizeof(n);
 	/* Getting SO_SNDBUF. */
-	if ( getsockopt(fd, SOL_SOCKET, SO_SNDBUF, &n, &len) == -1 )
+	if ( getsockopt(sock, SOL_SOCKET, SO_SNDBUF, &n, &len) == -1 )
 	{
 		perror("error getting socket buffer");
-		return FALSE;
+		goto error;
 	}
 
 	/* Setting the maximum SO_SNDBUF in bytes.
@@ -61,44 +144,67 @@ int createSocket(void)
 	for (n += 128; n < 10485760; n += 128)
 	{
 		/* Setting SO_SNDBUF. */
-		if ( setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &n, len) == -1 )
+		if ( setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &n, len) == -1 )
 		{
 			if(errno == ENOBUFS)	
 				break;
 
 			perror("error setting socket buffer");
-			return FALSE;
+			goto error;
 		}
 	}
 #endif /* SO_SNDBUF */
 
 #ifdef SO_BROADCAST
 	/* Setting SO_BROADCAST. */
-	if( setsockopt(fd, SOL_SOCKET, SO_BROADCAST, nptr, sizeof(n)) == -1 )
+	if( setsockopt(sock, SOL_SOCKET, SO_BROADCAST, nptr, sizeof(n)) == -1 )
 	{
 		perror("error setting socket broadcast");
-		return FALSE;
+		goto error;
 	}
 #endif /* SO_BROADCAST */
 
 #ifdef SO_PRIORITY
-	if( setsockopt(fd, SOL_SOCKET, SO_PRIORITY, nptr, sizeof(n)) == -1 )
+	if( setsockopt(sock, SOL_SOCKET, SO_PRIORITY, nptr, sizeof(n)) == -1 )
 	{
 		perror("error setting socket priority");
-		return FALSE;
+		goto error;
 	}
 #endif /* SO_PRIORITY */
 
-  return TRUE;
+  return sock;
+
+error:
+  close(sock);
+  return -1;
 }
 
-void closeSocket(void)
+void raw_close(void)
 {
   if (fd != -1)
+  {
+    if (txtime)
+      readDepartures(fd, TRUE);
     close(fd);
+  }
+  fd = -1;
+
+  closeTxtime();
+  txtime = FALSE;
+
+  free(batch_msgs);
+  free(batch_iovs);
+  free(batch_addrs);
+  free(batch_buffer);
+  free(batch_control);
+  batch_msgs = NULL;
+  batch_iovs = NULL;
+  batch_addrs = NULL;
+  batch_buffer = NULL;
+  batch_control = NULL;
 }
 
-int sendPacket(const void * const buffer, size_t size, const struct config_options * const __restrict__ co)
+int raw_send(const void * const buffer, size_t size, const struct config_options * const __restrict__ co)
 {
   struct sockaddr_in sin = {};  /* zero fill */
   void *p;
@@ -109,10 +215,41 @@ int sendPacket(const void * const buffer, size_t size, const struct config_optio
   assert(size > 0);
   assert(co != NULL);
 
+  /* Batched mode: queue a copy of the packet and send the whole batch when it's full. */
+  if (batch_size > 1)
+  {
+    void *slot;
+
+    /* NOTE: A bigger packet than the slots can hold only happens when options
+             change between modules (T50 protocol). Flush what we have and grow the slots. */
+    if (size > batch_slot_size)
+      if (!raw_flush() || !allocBatch(batch_size, size))
+        return FALSE;
+
+    slot = batch_buffer + batch_count * batch_slot_size;
+    memcpy(slot, buffer, size);
+
+    batch_iovs[batch_count].iov_len         = size;
+    batch_addrs[batch_count].sin_port        = htons(IPPORT_RND(co->dest));
+    batch_addrs[batch_count].sin_addr.s_addr = co->ip.daddr;
+
+    if (txtime)
+      setTxtime(&batch_msgs[batch_count].msg_hdr,
+                batch_control + batch_count * TXTIME_CONTROL_SIZE, pacing_txtime);
+
+    if (++batch_count == batch_size)
+      return raw_flush();
+
+    return TRUE;
+  }
+
   sin.sin_family      = AF_INET; 
   sin.sin_port        = htons(IPPORT_RND(co->dest)); 
   sin.sin_addr.s_addr = co->ip.daddr; 
 
+  if (txtime)
+    return sendTxtime(buffer, size, &sin);
+
   /* FIX: There is no garantee that sendto() will deliver the entire packet at once.
           So, we try MAX_SENDTO_TRIES times before giving up. */ 
   p = (void *)buffer;
@@ -122,10 +259,9 @@ int sendPacket(const void * const buffer, size_t size, const struct config_optio
 
     if (sent == -1)
     {
-      if (errno != EPERM)
+      if (!retrySend(&num_tries))
         goto error;
 
-      perror("");
       continue;
     }
 
@@ -143,3 +279,177 @@ error:
 
   return TRUE;
 }
+
+/* Sends all packets queued by raw_send() with as few sendmmsg() calls as possible. */
+int raw_flush(void)
+{
+  unsigned done;
+  int sent, num_tries;
+
+  /* sendmmsg() returns how many messages were sent. If an error occurs after the first
+     message, the call returns the partial count and the error is reported on the next
+     call, for the first message not sent. */
+  done = 0;
+  for (num_tries = MAX_SENDTO_TRIES; done < batch_count && num_tries--;)
+  {
+    sent = sendmmsg(fd, batch_msgs + done, batch_count - done, MSG_NOSIGNAL);
+
+    if (sent == -1)
+    {
+      if (!retrySend(&num_tries))
+        goto error;
+
+      continue;
+    }
+
+    done += sent;
+
+    /* Only consecutive failures count against the tries. */
+    num_tries = MAX_SENDTO_TRIES;
+  }
+
+  if (done < batch_count)
+  {
+error:
+    batch_count = 0;
+    ERROR("Error sending packet batch.");
+    return FALSE;
+  }
+
+  batch_count = 0;
+
+  if (txtime)
+    readDepartures(fd, FALSE);
+
+  return TRUE;
+}
+
+/* Sends a packet with its SCM_TXTIME. A datagram goes entirely, or not at all. */
+static int sendTxtime(const void * const buffer, size_t size, struct sockaddr_in *sin)
+{
+  char control[TXTIME_CONTROL_SIZE];
+  struct iovec iov = { (void *)buffer, size };
+  struct msghdr msg = {};
+  int num_tries;
+
+  msg.msg_name    = sin;
+  msg.msg_namelen = sizeof(struct sockaddr_in);
+  msg.msg_iov     = &iov;
+  msg.msg_iovlen  = 1;
+  setTxtime(&msg, control, pacing_txtime);
+
+  for (num_tries = MAX_SENDTO_TRIES; num_tries--;)
+  {
+    if (sendmsg(fd, &msg, MSG_NOSIGNAL) != -1)
+    {
+      if (++txtime_unread == TXTIME_READ_PACKETS)
+      {
+        txtime_unread = 0;
+        readDepartures(fd, FALSE);
+      }
+
+      return TRUE;
+    }
+
+    if (!retrySend(&num_tries))
+      break;
+  }
+
+  ERROR("Error sending packet.");
+  return FALSE;
+}
+
+/* (Re)allocates a batch of 'count' slots, 'slot_size' bytes each. 
+   NOTE: Must be called with an empty batch! The iovecs point inside the buffer. */
+static int allocBatch(unsigned count, size_t slot_size)
+{
+  unsigned i;
+  void *p;
+
+  assert(batch_count == 0);
+
+  /* Keep the slots aligned to cache lines. */
+  slot_size = (slot_size + 63) & ~(size_t)63;
+
+  if (batch_msgs == NULL)
+  {
+    batch_msgs  = calloc(count, sizeof(struct mmsghdr));
+    batch_iovs  = calloc(count, sizeof(struct iovec));
+    batch_addrs = calloc(count, sizeof(struct sockaddr_in));
+
+    if (txtime)
+      batch_control = calloc(count, TXTIME_CONTROL_SIZE);
+
+    if (batch_msgs == NULL || batch_iovs == NULL || batch_addrs == NULL ||
+        (txtime && batch_control == NULL))
+    {
+      ERROR("Error allocating packet batch");
+      return FALSE;
+    }
+  }
+
+  if ((p = realloc(batch_buffer, count * slot_size)) == NULL)
+  {
+    ERROR("Error allocating packet batch");
+    return FALSE;
+  }
+
+  batch_buffer = p;
+  batch_slot_size = slot_size;
+
+  for (i = 0; i < count; i++)
+  {
+    batch_iovs[i].iov_base = batch_buffer + i * slot_size;
+
+    batch_addrs[i].sin_family = AF_INET;
+
+    batch_msgs[i].msg_hdr.msg_name    = &batch_addrs[i];
+    batch_msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+    batch_msgs[i].msg_hdr.msg_iov     = &batch_iovs[i];
+    batch_msgs[i].msg_hdr.msg_iovlen  = 1;
+  }
+
+  return TRUE;
+}
+
+/* Decides, based on errno, if a failed send must be retried.
+   Returns FALSE if the error is fatal. */
+int retrySend(int *num_tries)
+{
+  countSendError(errno, errno == ENOBUFS || errno == EAGAIN);
+
+  switch (errno)
+  {
+    /* ENOBUFS means the device queue is full. Give the kernel a chance to drain it,
+       waiting 50 microseconds, twice as long on each try, up to 1 millisecond: The
+       MAX_SENDTO_TRIES tries give it about 100 milliseconds before giving up. */
+    case ENOBUFS:
+    case EAGAIN:
+      backoffSend(*num_tries);
+      return TRUE;
+
+    /* NOTE: An interrupted call doesn't count as a try. */
+    case EINTR:
+      (*num_tries)++;
+      return TRUE;
+
+    case EPERM:
+      perror("");
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+/* Waits before the next try, given the 'num_tries' left (see retrySend()). */
+void backoffSend(int num_tries)
+{
+  struct timespec backoff = { 0, 0 };
+  int used;
+
+  used = MAX_SENDTO_TRIES - 1 - num_tries;
+  backoff.tv_nsec = 50000L << (used < 5 ? used : 5);
+  if (backoff.tv_nsec > 1000000L)
+    backoff.tv_nsec = 1000000L;
+  nanosleep(&backoff, NULL);
+}
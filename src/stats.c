@@ -0,0 +1,365 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <common.h>
+#include <inttypes.h>
+#include <pthread.h>
+
+/* NOTE: Statistics.
+
+   Every worker counts what it sends on its own stats_t, inside its worker_t
+   (so on its own cache lines). The statistics thread wakes up every --stats
+   seconds, adds up the counters of all workers and prints the rates since the
+   last time. Counters are only read there, so workers never wait for it. */
+
+#define MINIMUM_CPU_NS 10000000     /* per core rates need 10 ms of CPU time */
+
+__thread stats_t *worker_stats = NULL;
+
+static const stats_t *first_stats = NULL;
+static size_t stats_stride;
+static unsigned num_stats;
+
+static pthread_t stats_thread;
+static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t stats_cond;
+static int stats_running = FALSE;
+static double stats_interval;
+
+static void *statsThread(void *);
+
+void countSendError(int err, int retried)
+{
+  if (worker_stats == NULL)
+    return;
+
+  if (err > 0 && err < STATS_ERRNOS)
+    statsAdd(&worker_stats->errors[err], 1);
+
+  if (retried)
+    statsAdd(&worker_stats->retries, 1);
+}
+
+uint64_t threadCpuTime(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Adds up the counters of all workers. */
+static void sumStats(stats_t *total)
+{
+  const stats_t *s;
+  unsigned i, j;
+
+  memset(total, 0, sizeof(stats_t));
+
+  for (i = 0; i < num_stats; i++)
+  {
+    s = (const void *)first_stats + i * stats_stride;
+
+    total->packets += __atomic_load_n(&s->packets, __ATOMIC_RELAXED);
+    total->bytes   += __atomic_load_n(&s->bytes, __ATOMIC_RELAXED);
+    total->retries += __atomic_load_n(&s->retries, __ATOMIC_RELAXED);
+    total->cpu_ns  += __atomic_load_n(&s->cpu_ns, __ATOMIC_RELAXED);
+
+    total->departures       += __atomic_load_n(&s->departures, __ATOMIC_RELAXED);
+    total->departure_ns     += __atomic_load_n(&s->departure_ns, __ATOMIC_RELAXED);
+    total->departure_abs_ns += __atomic_load_n(&s->departure_abs_ns, __ATOMIC_RELAXED);
+    total->txtime_dropped   += __atomic_load_n(&s->txtime_dropped, __ATOMIC_RELAXED);
+    if (total->departure_max_ns < __atomic_load_n(&s->departure_max_ns, __ATOMIC_RELAXED))
+      total->departure_max_ns = __atomic_load_n(&s->departure_max_ns, __ATOMIC_RELAXED);
+
+    for (j = 0; j < STATS_MODULES; j++)
+      total->modules[j] += __atomic_load_n(&s->modules[j], __ATOMIC_RELAXED);
+    for (j = 0; j < MAXIMUM_STREAMS; j++)
+    {
+      total->stream_packets[j] += __atomic_load_n(&s->stream_packets[j], __ATOMIC_RELAXED);
+      total->stream_bytes[j]   += __atomic_load_n(&s->stream_bytes[j], __ATOMIC_RELAXED);
+      if (total->stream_ns[j] < __atomic_load_n(&s->stream_ns[j], __ATOMIC_RELAXED))
+        total->stream_ns[j] = __atomic_load_n(&s->stream_ns[j], __ATOMIC_RELAXED);
+    }
+    for (j = 0; j < STATS_ERRNOS; j++)
+      total->errors[j] += __atomic_load_n(&s->errors[j], __ATOMIC_RELAXED);
+  }
+}
+
+static uint64_t sumErrors(const stats_t *s)
+{
+  uint64_t n;
+  unsigned i;
+
+  for (i = n = 0; i < STATS_ERRNOS; i++)
+    n += s->errors[i];
+
+  return n;
+}
+
+/* Prints 'value' with a SI prefix. */
+static void printRate(double value, const char *unit)
+{
+  static const char prefixes[] = " kMGT";
+  unsigned i;
+
+  for (i = 0; value >= 1000 && i < sizeof(prefixes) - 2; i++)
+    value /= 1000;
+
+  printf("%.3f %.*s%s", value, i != 0, &prefixes[i], unit);
+}
+
+/* Prints the totals of stream 'i', out of 'total'. Rates are over the time it
+   took ('seconds', the whole run, if it didn't end). */
+static void printStream(unsigned i, const stats_t *total, double seconds)
+{
+  const struct config_options *co = &streams[i].co;
+
+  if (total->stream_ns[i])
+    seconds = total->stream_ns[i] / 1e9;
+
+  printf("%s: stream %u: %" PRIu64 " packets, %" PRIu64 " bytes", PACKAGE, i + 1,
+         total->stream_packets[i], total->stream_bytes[i]);
+
+  if (seconds > 0)
+  {
+    printf(" (");
+    printRate(total->stream_packets[i] / seconds, "pps");
+    if (co->rate)
+    {
+      printf(", target ");
+      printRate(co->rate, "pps");
+    }
+    printf("; ");
+    printRate(total->stream_bytes[i] * 8 / seconds, "bit/s");
+    if (co->bitrate)
+    {
+      printf(", target ");
+      printRate(co->bitrate, "bit/s");
+    }
+    printf(")");
+  }
+
+  printf(": %s\n", streams[i].args);
+}
+
+int startStats(const struct config_options * const __restrict__ co,
+               const stats_t *stats, size_t stride, unsigned count)
+{
+  pthread_condattr_t attr;
+
+  assert(co != NULL);
+  assert(stats != NULL);
+  assert(getNumberOfRegisteredModules() <= STATS_MODULES);
+
+  first_stats = stats;
+  stats_stride = stride;
+  num_stats = count;
+
+  if (co->stats == 0)
+    return TRUE;
+
+  stats_interval = co->stats;
+
+  /* The thread waits on the condition with a timeout, so it stops right away. */
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&stats_cond, &attr);
+  pthread_condattr_destroy(&attr);
+
+  stats_running = TRUE;
+  if ((errno = pthread_create(&stats_thread, NULL, statsThread, NULL)) != 0)
+  {
+    perror("Error creating statistics thread");
+    stats_running = FALSE;
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+void stopStats(void)
+{
+  if (!stats_running)
+    return;
+
+  pthread_mutex_lock(&stats_mutex);
+  stats_running = FALSE;
+  pthread_cond_signal(&stats_cond);
+  pthread_mutex_unlock(&stats_mutex);
+
+  pthread_join(stats_thread, NULL);
+  pthread_cond_destroy(&stats_cond);
+}
+
+/* Absolute deadlines: The interval doesn't drift with the printing. */
+static void nextDeadline(struct timespec *ts)
+{
+  ts->tv_sec  += (time_t)stats_interval;
+  ts->tv_nsec += (stats_interval - (time_t)stats_interval) * 1e9;
+  if (ts->tv_nsec >= 1000000000)
+  {
+    ts->tv_sec++;
+    ts->tv_nsec -= 1000000000;
+  }
+}
+
+static void *statsThread(void *arg)
+{
+  stats_t *base, *last, *now, *tmp;
+  struct timespec deadline;
+  uint64_t t0, t1;
+  double seconds;
+
+  if ((base = calloc(2, sizeof(stats_t))) == NULL)
+    return NULL;
+  last = base;
+  now = base + 1;
+
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+  nextDeadline(&deadline);
+  t0 = pacingClock();
+
+  pthread_mutex_lock(&stats_mutex);
+  while (stats_running)
+  {
+    if (pthread_cond_timedwait(&stats_cond, &stats_mutex, &deadline) != ETIMEDOUT)
+      continue;
+
+    sumStats(now);
+    t1 = pacingClock();
+    seconds = (t1 - t0) / 1e9;
+
+    printf("%s: ", PACKAGE);
+    printRate((now->packets - last->packets) / seconds, "pps, ");
+    printRate((now->bytes - last->bytes) * 8 / seconds, "bit/s, ");
+    printf("%" PRIu64 " retries, %" PRIu64 " errors\n",
+           now->retries - last->retries,
+           sumErrors(now) - sumErrors(last));
+    fflush(stdout);
+
+    tmp = last; last = now; now = tmp;
+    t0 = t1;
+
+    nextDeadline(&deadline);
+  }
+  pthread_mutex_unlock(&stats_mutex);
+
+  free(base);
+  return NULL;
+}
+
+void printSummary(const struct config_options * const __restrict__ co, uint64_t elapsed_ns)
+{
+  stats_t *total;
+  double seconds;
+  unsigned i, used;
+
+  assert(co != NULL);
+
+  if (first_stats == NULL || (total = malloc(sizeof(stats_t))) == NULL)
+    return;
+
+  sumStats(total);
+  seconds = elapsed_ns / 1e9;
+
+  printf("%s: %" PRIu64 " packets, %" PRIu64 " bytes in %.3f s: ",
+         PACKAGE, total->packets, total->bytes, seconds);
+
+  if (seconds > 0)
+  {
+    printRate(total->packets / seconds, "pps");
+    if (co->rate)
+    {
+      printf(" (target ");
+      printRate(co->rate, "pps");
+      printf(")");
+    }
+    printf(", ");
+    printRate(total->bytes * 8 / seconds, "bit/s");
+    if (co->bitrate)
+    {
+      printf(" (target ");
+      printRate(co->bitrate, "bit/s");
+      printf(")");
+    }
+  }
+  putchar('\n');
+
+  if (co->sizes != NULL && total->packets)
+    printf("%s: %.1f bytes per packet on average\n", PACKAGE, (double)total->bytes / total->packets);
+
+  /* NOTE: Only the workers' time. Kernel work done later (softirqs) isn't included.
+           A few clock ticks of it would give meaningless rates. */
+  if (total->cpu_ns && total->cpu_ns < MINIMUM_CPU_NS)
+    printf("%s: %.3f s of CPU time: n/a per core\n", PACKAGE, total->cpu_ns / 1e9);
+  else if (total->cpu_ns)
+  {
+    printf("%s: %.3f s of CPU time: ", PACKAGE, total->cpu_ns / 1e9);
+    printRate(total->bytes * 8 / (total->cpu_ns / 1e9), "bit/s");
+    printf(", ");
+    printRate(total->packets / (total->cpu_ns / 1e9), "pps");
+    printf(" per core\n");
+  }
+
+  /* How far from their --txtime the packets left. */
+  if (total->departures)
+    printf("%s: %" PRIu64 " departures timestamped, %.3f us off schedule on average "
+           "(%.3f us absolute, %.3f us worst)\n", PACKAGE, total->departures,
+           (int64_t)total->departure_ns / 1e3 / total->departures,
+           total->departure_abs_ns / 1e3 / total->departures,
+           total->departure_max_ns / 1e3);
+  if (total->txtime_dropped)
+    printf("%s: %" PRIu64 " packets dropped by the qdisc (transmit time missed)\n",
+           PACKAGE, total->txtime_dropped);
+
+  /* The pool is built with a single shard. Streams have their own destinations. */
+  if (num_streams == 0)
+    printCoverage(co, total->packets, pool_count ? 1 : num_stats);
+
+  for (i = 0; i < num_streams; i++)
+    printStream(i, total, seconds);
+
+  /* Packets per protocol, when there's more than one, and their share and rate (see --protocol-mix). */
+  for (i = used = 0; i < STATS_MODULES; i++)
+    used += total->modules[i] != 0;
+
+  if (used > 1)
+    for (i = 0; mod_table[i].func != NULL; i++)
+      if (total->modules[i])
+      {
+        printf("%s: %-8s %" PRIu64 " packets (%.2f%%", PACKAGE, mod_table[i].acronym,
+               total->modules[i], total->modules[i] * 100.0 / total->packets);
+        if (seconds > 0)
+        {
+          printf(", ");
+          printRate(total->modules[i] / seconds, "pps");
+        }
+        printf(")\n");
+      }
+
+  if (total->retries)
+    printf("%s: %" PRIu64 " sends retried (device queue full)\n", PACKAGE, total->retries);
+
+  for (i = 1; i < STATS_ERRNOS; i++)
+    if (total->errors[i])
+      printf("%s: %" PRIu64 " sends failed: %s\n", PACKAGE, total->errors[i], strerror(i));
+
+  free(total);
+}
@@ -0,0 +1,89 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <common.h>
+
+/* NOTE: Traffic streams (--stream).
+
+   Each stream is a run of its own: Protocol and header options, threshold,
+   rates, --sizes and target, starting from the command line ones. What the
+   workers share (threads, backend, payload file, --protocol-mix, ...) is set
+   on the command line only. Every worker sends its share of every stream, the
+   one due first each time (see streamLoop()), so a single process keeps all
+   the rates. Sizes and templates are kept per stream, selected by
+   current_stream; the payload is shared, each stream taking as much of it as
+   it needs. */
+
+stream_t *streams = NULL;
+unsigned  num_streams = 0;
+
+__thread unsigned current_stream = 0;
+
+int addStream(const struct config_options * const __restrict__ co, const char *args)
+{
+  stream_t *p;
+
+  assert(co != NULL);
+
+  if ((p = realloc(streams, (num_streams + 1) * sizeof(stream_t))) == NULL)
+  {
+    ERROR("Error allocating streams");
+    return FALSE;
+  }
+
+  streams = p;
+  p += num_streams++;
+
+  memset(p, 0, sizeof(stream_t));
+  p->co = *co;
+  p->args = args;
+
+  return TRUE;
+}
+
+int initStreams(void)
+{
+  struct cidr *cidr;
+  size_t longest;
+  unsigned i;
+
+  for (i = 0, longest = 0; i < num_streams; i++)
+  {
+    /* NOTE: config_cidr() keeps a single cidr. Each stream gets a copy. */
+    if ((cidr = config_cidr(streams[i].co.bits, streams[i].co.ip.daddr)) == NULL)
+      return FALSE;
+    streams[i].cidr = *cidr;
+
+    /* As without streams: --payload-size bytes, or the whole file. */
+    streams[i].payload = streams[i].co.payload_size;
+    if (streams[i].payload == 0 && streams[i].co.payload_file != NULL)
+      streams[i].payload = payload_length;
+    if (streams[i].payload > longest)
+      longest = streams[i].payload;
+  }
+
+  return extendPayload(longest);
+}
+
+void freeStreams(void)
+{
+  free(streams);
+  streams = NULL;
+  num_streams = 0;
+}
@@ -18,9 +18,6 @@
 */
 
 #include <common.h>
-#include <sys/wait.h> /* POSIX.1 compliant */
-
-static pid_t pid = -1;      /* -1 is a trick used when __HAVE_TURBO__ isn't defined. */
 
 static void initialize(void);
 static const char *getOrdinalSuffix(unsigned);
@@ -31,8 +28,6 @@ int main(int argc, char *argv[])
 {
   struct config_options *co;  /* Pointer to options. */
   struct cidr *cidr_ptr;      /* Pointer to cidr host id and 1st ip address. */
-  modules_table_t *ptbl;      /* Pointer to modules table */
-  uint8_t proto;              /* Used on main loop. */
 
   initialize();
 
@@ -40,9 +35,15 @@ int main(int argc, char *argv[])
   if ((co = getConfigOptions(argc, argv)) == NULL)
     return EXIT_FAILURE;
 
+  /* Packets written to the standard output: Messages go to the standard error. */
+  if ((backend_table[co->backend].flags & BACKEND_FILE) && co->output != NULL && !strcmp(co->output, "-"))
+    if (!pcapStdout())
+      return EXIT_FAILURE;
+
   /* This is a requirement of t50. User must be root to use it. 
-     Previously on checkConfigOptions(). */
-  if (getuid())
+     Previously on checkConfigOptions(). 
+     NOTE: Except when the packets don't go to the network. */
+  if (getuid() && !(backend_table[co->backend].flags & BACKEND_NO_ROOT) && !co->bench)
   {
     ERROR("User must have root priviledge to run.");
     return EXIT_FAILURE;
@@ -52,57 +53,54 @@ int main(int argc, char *argv[])
   if (!checkConfigOptions(co))
     return EXIT_FAILURE;
 
-  /* Setting socket file descriptor. */
-  /* NOTE: createSocket() handles its own errors before returning. */
-  if (!createSocket())
+  /* Selects and seeds the random number generator. */
+  initRandom(co);
+
+  /* Reads the --targets file and resolves its names, if any. */
+  if (!loadTargets(co))
+    return EXIT_FAILURE;
+
+  /* Maps or generates the payload, the same on every packet. */
+  if (!loadPayload(co))
     return EXIT_FAILURE;
 
-  /* Setup random seed using current date/time timestamp. */
-  /* NOTE: Random seed don't need to be so precise! */
-  SRANDOM(time(NULL));
+  /* Destinations and payload of each --stream, if any. */
+  if (!initStreams())
+    return EXIT_FAILURE;
 
-#ifdef  __HAVE_TURBO__
-  /* Entering in TURBO. */
-  if (co->turbo)
-  {
-    /* Decides if it's necessary to fork a new process. */
-    if ((co->ip.protocol == IPPROTO_T50 && co->threshold > (threshold_t)getNumberOfRegisteredModules()) || 
-        (co->ip.protocol != IPPROTO_T50 && co->threshold > 1))
-    {
-      threshold_t new_threshold;
-
-      if ((pid = fork()) == -1)
-      {
-        perror("Error creating child process. Exiting...");
-        return EXIT_FAILURE;
-      }
-
-      /* Setting the priority to both parent and child process to highly favorable scheduling value. */
-      /* FIXME: Why not setup this value when t50 runs as a single process? */
-      if (setpriority(PRIO_PROCESS, PRIO_PROCESS, -15)  == -1)
-      {
-        perror("Error setting process priority. Exiting...");
-        return EXIT_FAILURE;
-      }
-
-      /* Divide the process iterations in main loop between processes. */
-      new_threshold = co->threshold / 2; 
-
-      /* FIX: Ooops! Parent process get the extra packet, if given threshold is odd. */
-      if ((co->threshold % 2) && !IS_CHILD_PID(pid))
-        new_threshold++;
-
-      co->threshold = new_threshold;
-    }
-  }
-#endif  /* __HAVE_TURBO__ */
+  /* Packet sizes drawn from --sizes, if any. */
+  if (!initSizes(co))
+    return EXIT_FAILURE;
+
+  /* Order of the modules of --protocol T50, from --protocol-mix. */
+  if (!initMix(co))
+    return EXIT_FAILURE;
+
+  /* Maps and indexes the --replay file, if any. */
+  if (!loadReplay(co))
+    return EXIT_FAILURE;
+
+  /* Builds the packets once, to find out what changes between them. */
+  compileTemplates(co);
+
+  /* Only times the packet building. */
+  if (co->bench)
+    return runBenchmark(co) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+  /* Setting up the workers and the first socket. */
+  /* NOTE: initWorkers() handles its own errors before returning. */
+  if (!initWorkers(co))
+    return EXIT_FAILURE;
 
   /* Calculates CIDR for destination address. */
   if ((cidr_ptr = config_cidr(co->bits, co->ip.daddr)) == NULL)
     return EXIT_FAILURE;
 
-  /* Show launch info only for parent process. */
-  if (!IS_CHILD_PID(pid))
+  /* Pre-generates the packets, if asked to. */
+  if (!buildPool(co, cidr_ptr))
+    return EXIT_FAILURE;
+
+  /* Show launch info. */
   {
     time_t lt;
     struct tm *tm;
@@ -123,60 +121,23 @@ int main(int argc, char *argv[])
       tm->tm_sec);
   }
 
-  /* Selects the initial protocol to use. */
-  proto = co->ip.protocol;
-  ptbl = mod_table;
-  if (proto != IPPROTO_T50)
-    ptbl += co->ip.protoname;
-
-  /* Preallocate packet buffer. */
-  alloc_packet(INITIAL_PACKET_SIZE);
-
-  /* Execute if flood or while threshold greater than 0. */
-  while (co->flood || (co->threshold-- > 0))
-  {
-    /* Holds the actual packet size after module function call. */
-    size_t size;
-
-    /* Set the destination IP address to RANDOM IP address. */
-    /* NOTE: The previous code did not account for 'hostid == 0'! */
-    co->ip.daddr = cidr_ptr->__1st_addr;
-    if (cidr_ptr->hostid)
-      co->ip.daddr += RANDOM() % cidr_ptr->hostid;
-    co->ip.daddr = htonl(co->ip.daddr);
-
-    /* Calls the 'module' function and sends the packet. */
-    co->ip.protocol = ptbl->protocol_id;
-    ptbl->func(co, &size);
+  /* Runs all workers, the first one on this thread. */
+  if (!runWorkers(cidr_ptr))
+    return EXIT_FAILURE;
 
-    if (!sendPacket(packet, size, co))
-      return EXIT_FAILURE;
-  
-    /* If protocol if 'T50', then get the next true protocol. */
-    if (proto == IPPROTO_T50)
-      if ((++ptbl)->func == NULL)
-        ptbl = mod_table;
-  }
+  freePool();
+  freeSizes();
+  freeMix();
+  freePayload();
+  freeReplay();
+  freeTargets();
+  freeStreams();
 
-  /* Show termination message only for parent process. */
-  if (!IS_CHILD_PID(pid))
+  /* Show termination message. */
   {
     time_t lt;
     struct tm *tm;
 
-#ifdef  __HAVE_TURBO__
-    int status;
-
-    /* Wait 5 seconds for child process, then ungracefully closes the program. */
-    alarm(5);
-    wait(&status);
-#endif
-
-    /* FIX: To graciously end the program, only the parent process can close the socket. 
-       NOTE: I realize that closing descriptors are reference counted.
-             Kept the logic just in case! */
-    closeSocket();
-
     /* Getting the local time. */
     lt = time(NULL); 
     tm = localtime(&lt);
@@ -200,22 +161,8 @@ int main(int argc, char *argv[])
 static void signal_handler(int signal)
 {
   /* Make sure the socket descriptor is closed. 
-     FIX: But only if this is the parent process. Closing the cloned descriptor on the
-          child process can be catastrophic to the parent. 
-     NOTE: I realize that the act of closing descriptors are reference counted.
-           Keept the logic just in case! */
-#ifdef __HAVE_TURBO__
-  if (!IS_CHILD_PID(pid))
-  {
-    /* Kills the child process! */
-    kill(pid, SIGKILL);
-#endif
-
-      closeSocket();
-
-#ifdef __HAVE_TURBO__
-  }
-#endif
+     NOTE: Only the interrupted thread's socket. Exiting closes the others. */
+  closeSocket();
 
   /* FIX: The shell documentation (bash) specifies that a process
           when exits because a signal, must return 128+signal#. */
@@ -243,17 +190,6 @@ static void initialize(void)
   sigaction(SIGTRAP, &sa, NULL);
   sigaction(SIGTERM, &sa, NULL);
   sigaction(SIGTSTP, &sa, NULL);
-#ifdef  __HAVE_TURBO__
-  /* FIX: Is it wise to simply terminate the main process
-          if the child terminates? 
-
-          Maybe it is wiser if we implement some kind of
-          timeout when waiting for the child to terminate. */
-  sigaction(SIGALRM, &sa, NULL);
-
-  sa.sa_handler = SIG_IGN;
-  sigaction(SIGCHLD, &sa, NULL);
-#endif
 
   /* --- Make sure stdout is unbuffered (otherwise, it's line buffered). --- */
   fflush(stdout);
@@ -0,0 +1,319 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <common.h>
+#include <ctype.h>
+#include <inttypes.h>
+#include <pthread.h>
+
+/* NOTE: Target list (--targets).
+
+   One HOST[/BITS] [WEIGHT] per line, '#' starting a comment. Names are
+   resolved before the launch, each one once (however many lines have it), by
+   TARGETS_RESOLVERS threads at a time. Entries are drawn from an alias table
+   (see alias.c, as --sizes): A column picked at random, then either its own
+   entry or its alias. The table is a flat array of 16 bytes entries, so a draw
+   takes two or three random words and one or two loads, however many entries
+   there are. The weight is the entry's, shared by all its hosts. */
+
+#define TARGETS_RESOLVERS 16        /* resolving threads                */
+
+/* An entry, as read. */
+typedef struct {
+  char     *name;                   /* NULL: an address                 */
+  uint32_t  addr;                   /* host order                       */
+  uint32_t  bits;
+  double    weight;
+} target_line_t;
+
+/* Names to resolve, one per resolving thread at a time. */
+typedef struct {
+  target_line_t **lines;            /* sorted by name                   */
+  uint32_t  count;
+  uint32_t  next;
+} resolver_arg_t;
+
+target_t *targets = NULL;
+uint32_t  num_targets = 0;
+
+static int  parseTargets(const char *, target_line_t **);
+static int  resolveTargets(target_line_t *, uint32_t *);
+static void *resolverThread(void *);
+static int  compareNames(const void *, const void *);
+
+int loadTargets(const struct config_options * const __restrict__ co)
+{
+  target_line_t *lines = NULL;
+  double *weights;
+  uint64_t addresses;
+  uint32_t i, names;
+  struct timespec t0, t1;
+  int status;
+
+  assert(co != NULL);
+
+  if (co->targets == NULL)
+    return TRUE;
+
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+
+  status = parseTargets(co->targets, &lines) && resolveTargets(lines, &names);
+
+  if (status && (posix_memalign((void **)&targets, CACHE_LINE_SIZE, num_targets * sizeof(target_t)) ||
+                 (weights = malloc(num_targets * sizeof(double))) == NULL))
+  {
+    ERROR("Error allocating targets");
+    status = FALSE;
+  }
+
+  if (status)
+  {
+    /* Like config_cidr(): Without the network and broadcast addresses. */
+    for (i = 0, addresses = 0; i < num_targets; i++)
+    {
+      if (lines[i].bits < CIDR_MAXIMUM - 1)
+      {
+        targets[i].first = (lines[i].addr & ~(0xffffffffU >> lines[i].bits)) + 1;
+        targets[i].hosts = (1U << (32 - lines[i].bits)) - 2;
+      }
+      else
+      {
+        targets[i].first = lines[i].addr;
+        targets[i].hosts = 1;
+      }
+
+      addresses += targets[i].hosts;
+      weights[i] = lines[i].weight;
+    }
+
+    status = buildAliasTable(&targets->column, num_targets, sizeof(target_t), weights);
+    free(weights);
+  }
+
+  for (i = 0; i < num_targets; i++)
+    free(lines[i].name);
+  free(lines);
+
+  if (!status)
+  {
+    freeTargets();
+    return FALSE;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+
+  printf("%s: %u targets, %" PRIu64 " addresses from '%s' (%u names resolved in %.3f s)\n",
+         PACKAGE, num_targets, addresses, co->targets, names,
+         (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9);
+
+  return TRUE;
+}
+
+void freeTargets(void)
+{
+  free(targets);
+  targets = NULL;
+  num_targets = 0;
+}
+
+/* Reads the entries of 'file' to 'lines' (num_targets of them). */
+static int parseTargets(const char *file, target_line_t **lines)
+{
+  FILE *f;
+  char *line = NULL, *host, *weight, *extra, *bits, *save, *end;
+  size_t line_size = 0;
+  uint32_t allocated = 0, number = 0;
+  target_line_t *t, *p;
+  struct in_addr in;
+  int status = TRUE;
+
+  if ((f = fopen(file, "r")) == NULL)
+  {
+    fprintf(stderr, "%s: cannot open targets file '%s': %s\n", PACKAGE, file, strerror(errno));
+    return FALSE;
+  }
+
+  while (status && getline(&line, &line_size, f) != -1)
+  {
+    number++;
+
+    if ((end = strchr(line, '#')) != NULL)
+      *end = '\0';
+
+    if ((host = strtok_r(line, " \t\r\n", &save)) == NULL)
+      continue;
+    weight = strtok_r(NULL, " \t\r\n", &save);
+    extra = strtok_r(NULL, " \t\r\n", &save);
+
+    if (num_targets == allocated)
+    {
+      allocated = allocated ? allocated * 2 : 256;
+      if ((p = realloc(*lines, allocated * sizeof(target_line_t))) == NULL)
+      {
+        ERROR("Error allocating targets");
+        status = FALSE;
+        break;
+      }
+      *lines = p;
+    }
+
+    t = *lines + num_targets;
+    t->name = NULL;
+    t->addr = 0;
+    t->bits = CIDR_MAXIMUM;
+    t->weight = 1.0;
+
+    if ((bits = strchr(host, '/')) != NULL)
+    {
+      *bits++ = '\0';
+      t->bits = strtoul(bits, &end, 10);
+      if (!isdigit(*bits) || *end != '\0')
+        t->bits = 0;
+    }
+
+    if (weight != NULL)
+    {
+      t->weight = strtod(weight, &end);
+      if (*end != '\0')
+        t->weight = 0;
+    }
+
+    if (*host == '\0' || extra != NULL || t->bits < CIDR_MINIMUM || t->bits > CIDR_MAXIMUM ||
+        !(t->weight > 0))
+    {
+      fprintf(stderr, "%s: targets file '%s', line %u: invalid target "
+                      "(HOST[/BITS] [WEIGHT], bits from %d to %d)\n",
+              PACKAGE, file, number, CIDR_MINIMUM, CIDR_MAXIMUM);
+      status = FALSE;
+      break;
+    }
+
+    if (inet_pton(AF_INET, host, &in) == 1)
+      t->addr = ntohl(in.s_addr);
+    else if ((t->name = strdup(host)) == NULL)
+    {
+      ERROR("Error allocating targets");
+      status = FALSE;
+      break;
+    }
+
+    num_targets++;
+  }
+
+  free(line);
+  fclose(f);
+
+  if (status && num_targets == 0)
+  {
+    fprintf(stderr, "%s: no targets on '%s'\n", PACKAGE, file);
+    status = FALSE;
+  }
+
+  return status;
+}
+
+/* Resolves the names of 'lines', each one once. 'names' gets how many there were. */
+static int resolveTargets(target_line_t *lines, uint32_t *names)
+{
+  pthread_t threads[TARGETS_RESOLVERS];
+  resolver_arg_t arg;
+  target_line_t **sorted;
+  uint32_t i, n, created;
+  int status = TRUE;
+
+  *names = 0;
+
+  if ((sorted = malloc(2 * num_targets * sizeof(target_line_t *))) == NULL)
+  {
+    ERROR("Error allocating targets");
+    return FALSE;
+  }
+
+  for (i = n = 0; i < num_targets; i++)
+    if (lines[i].name != NULL)
+      sorted[n++] = &lines[i];
+
+  qsort(sorted, n, sizeof(target_line_t *), compareNames);
+
+  /* The first line of each name is resolved. */
+  arg.lines = sorted + num_targets;
+  arg.count = arg.next = 0;
+
+  for (i = 0; i < n; i++)
+    if (i == 0 || strcmp(sorted[i]->name, sorted[i - 1]->name))
+      arg.lines[arg.count++] = sorted[i];
+
+  for (created = 0; created < TARGETS_RESOLVERS && created < arg.count; created++)
+    if ((errno = pthread_create(&threads[created], NULL, resolverThread, &arg)) != 0)
+    {
+      /* The others (or this thread) will do. */
+      if (created == 0)
+        resolverThread(&arg);
+      break;
+    }
+
+  for (i = 0; i < created; i++)
+    pthread_join(threads[i], NULL);
+
+  for (i = 0; i < arg.count; i++)
+    if (arg.lines[i]->addr == INADDR_ANY)
+    {
+      fprintf(stderr, "%s: cannot resolve target '%s'\n", PACKAGE, arg.lines[i]->name);
+      status = FALSE;
+    }
+
+  /* Lines repeating a name take the address of its first one. */
+  for (i = 1; i < n; i++)
+    if (!strcmp(sorted[i]->name, sorted[i - 1]->name))
+      sorted[i]->addr = sorted[i - 1]->addr;
+
+  *names = arg.count;
+  free(sorted);
+  return status;
+}
+
+/* Takes the next name until there are none left. INADDR_ANY marks a failure. */
+static void *resolverThread(void *p)
+{
+  resolver_arg_t *arg = p;
+  struct addrinfo hints = {}, *res;
+  target_line_t *t;
+  uint32_t i;
+
+  hints.ai_family = AF_INET;
+
+  while ((i = __sync_fetch_and_add(&arg->next, 1)) < arg->count)
+  {
+    t = arg->lines[i];
+    t->addr = INADDR_ANY;
+
+    if (getaddrinfo(t->name, NULL, &hints, &res) == 0)
+    {
+      t->addr = ntohl(((struct sockaddr_in *)res->ai_addr)->sin_addr.s_addr);
+      freeaddrinfo(res);
+    }
+  }
+
+  return NULL;
+}
+
+static int compareNames(const void *a, const void *b)
+{
+  return strcmp((*(target_line_t * const *)a)->name, (*(target_line_t * const *)b)->name);
+}
@@ -0,0 +1,874 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <common.h>
+
+/* NOTE: How templates are compiled.
+
+   Each module is called several times while RANDOM() is hooked: Once with random
+   values, then once per RANDOM() call with only that value changed, then with a
+   different destination address. Comparing the packets tells where each value is
+   stored (and how: big or little endian, 32, 16, 8 bits or a bit field). Changed bytes that
+   aren't a value must be checksums. Their regions are found by checking which
+   region [start, end) holding the checksum sums to 0xffff on every packet.
+
+   Checksums are updated as in RFC 1624, from the bytes changed on the previous packet,
+   when that's cheaper than summing their region again (few fields inside it), every
+   field or checksum word is entirely inside or outside it and the region has some
+   constant byte not zero (so the result is the same as cksum()). Otherwise they're
+   recalculated (inline, for the few bytes of a header). In practice, only the
+   checksums covering a payload are updated: Header only ones have too many fields
+   for their size.
+
+   Per packet, the module's random values are taken from the ring at once (see
+   takeRandom()) and only stored on the fields.
+
+   Finally, the template is checked against a few packets built by the module. Any
+   difference (values used as lengths, counts, etc) and the module is used as is.
+   The module is also used unless the template is measured faster: Patching many
+   fields may cost more than building the packet, specially with a fast --rng.
+   --force-template (default on debug builds) keeps every template that reproduces
+   the module. */
+
+#define MAX_DRAWS         RANDOM_RING_SIZE  /* RANDOM() calls per packet (see takeRandom()) */
+#define MAX_FIELDS        512
+#define MAX_CKSUMS        8
+#define VERIFY_SAMPLES    16
+#define TIMING_PACKETS    64      /* packets built per timing round      */
+#define TIMING_ROUNDS     5
+#define DRAW_DADDR        0xffff  /* field holding the destination address */
+#define INLINE_SUM_LENGTH 64      /* longer regions are summed by cksum() */
+#define FIELD_CKSUM_COST  16      /* bytes cksum() sums in the time a field
+                                     update takes (see setIncremental()) */
+
+/* How a value is stored on the packet. */
+enum { FIELD_BE32, FIELD_HOST32, FIELD_BE16, FIELD_HOST16, FIELD_U8, FIELD_BITS };
+
+typedef struct {
+  uint16_t offset;
+  uint16_t draw;                  /* RANDOM() call index or DRAW_DADDR */
+  uint8_t  type;
+  uint8_t  mask;                  /* FIELD_BITS only: bits of the byte  */
+  uint8_t  shift;
+  uint8_t  cksums;                /* incremental checksums covering it  */
+} template_field_t;
+
+typedef struct {
+  uint16_t offset;                /* checksum word */
+  uint16_t start;                 /* region covered by the checksum */
+  uint16_t length;
+  uint8_t  incremental;
+  uint8_t  outer;                 /* incremental checksums covering it  */
+} template_cksum_t;
+
+typedef struct {
+  size_t            size;
+  void             *base;
+  unsigned          num_fields;
+  unsigned          num_cksums;
+  unsigned          num_draws;
+  int               incremental;            /* any checksum is */
+  template_field_t  fields[MAX_FIELDS];     /* sorted by draw */
+  template_cksum_t  cksums[MAX_CKSUMS];     /* inner regions first */
+} template_t;
+
+/* A packet built by a module while RANDOM() is hooked. */
+typedef struct {
+  size_t    size;
+  uint8_t  *data;
+  unsigned  draws;
+  uint32_t  values[MAX_DRAWS];
+} sample_t;
+
+__thread uint32_t (*random_hook)(void) = NULL;
+
+/* Templates, indexed as mod_table, a table per stream (see current_stream).
+   Read only after compileTemplates(). */
+static template_t **templates = NULL;
+static unsigned num_modules = 0;
+static unsigned num_tables = 0;
+
+/* Buffer and template of the last packet built, to skip copying the template again. */
+static __thread const void *last_buffer = NULL;
+static __thread const template_t *last_template = NULL;
+
+/* RANDOM() recording. */
+static __thread const uint32_t *script;
+static __thread unsigned script_len;
+static __thread sample_t *recording;
+
+static void compileTable(template_t **, const struct config_options * const __restrict__);
+static template_t *compileTemplate(modules_table_t *, struct config_options *);
+static int  buildSample(modules_table_t *, struct config_options *, in_addr_t, const uint32_t *, unsigned, sample_t *);
+static int  findFields(template_t *, const sample_t *, const sample_t *, uint16_t, uint32_t, uint32_t, uint8_t *);
+static int  findBitFields(template_t *, const sample_t *, unsigned, unsigned, uint32_t, uint32_t, uint8_t *);
+static int  compareFields(const void *, const void *);
+static int  findCksum(template_t *, const sample_t *, unsigned, uint16_t, uint8_t *);
+static int  isSlower(const template_t *, modules_table_t *, struct config_options *);
+static void setIncremental(template_t *, const uint8_t *, const uint8_t *);
+static uint16_t foldSum(uint64_t);
+static void patchTemplate(const template_t *, void *, in_addr_t, const uint32_t *);
+
+/* Bytes written by a field. */
+static inline size_t fieldWidth(int type)
+{
+  switch (type)
+  {
+    case FIELD_BE32:
+    case FIELD_HOST32: return 4;
+    case FIELD_BE16:
+    case FIELD_HOST16: return 2;
+  }
+
+  return 1;
+}
+
+void compileTemplates(const struct config_options * const __restrict__ co)
+{
+  unsigned i;
+
+  assert(co != NULL);
+
+  freeTemplates();
+
+  num_modules = getNumberOfRegisteredModules();
+  num_tables = num_streams ? num_streams : 1;
+
+  templates = calloc(num_tables * num_modules, sizeof(template_t *));
+  if (templates == NULL)
+    return;
+
+  /* Without streams, the command line options have the first table. */
+  for (i = 0; i < num_tables; i++)
+  {
+    /* Streams' templates carry their own payload. */
+    current_stream = i;
+    if (num_streams)
+      setPayloadSize(streams[i].payload);
+
+    compileTable(templates + i * num_modules, num_streams ? &streams[i].co : co);
+  }
+
+  current_stream = 0;
+}
+
+/* Compiles the templates of the modules 'co' uses (and its sizes allow) to 'table'. */
+static void compileTable(template_t **table, const struct config_options * const __restrict__ co)
+{
+  struct config_options tmp;
+  modules_table_t *ptbl;
+  unsigned i;
+
+  if (co->no_template)
+    return;
+
+  /* NOTE: Modules get a copy, since their options are changed here. */
+  tmp = *co;
+
+  for (i = 0, ptbl = mod_table; ptbl->func != NULL; ptbl++, i++)
+    if (co->ip.protocol == IPPROTO_T50 || (int)i == (int)co->ip.protoname)
+    {
+      /* NOTE: Templates have a single size. */
+      if (hasSizes(ptbl))
+        continue;
+
+      tmp.ip.protocol = ptbl->protocol_id;
+      table[i] = compileTemplate(ptbl, &tmp);
+    }
+}
+
+void freeTemplates(void)
+{
+  size_t i, n;
+
+  if (templates == NULL)
+    return;
+
+  for (i = 0, n = (size_t)num_tables * num_modules; i < n; i++)
+    if (templates[i] != NULL)
+    {
+      free(templates[i]->base);
+      free(templates[i]);
+    }
+
+  free(templates);
+  templates = NULL;
+  num_tables = 0;
+  last_template = NULL;
+}
+
+int hasTemplate(modules_table_t *ptbl)
+{
+  return templates != NULL && templates[current_stream * num_modules + (ptbl - mod_table)] != NULL;
+}
+
+void buildPacket(modules_table_t *ptbl, const struct config_options * const __restrict__ co, size_t *size)
+{
+  const template_t *t;
+
+  t = templates ? templates[current_stream * num_modules + (ptbl - mod_table)] : NULL;
+
+  if (t == NULL)
+  {
+    last_template = NULL;
+    drawSize(ptbl);
+    ptbl->func(co, size);
+    return;
+  }
+
+  alloc_packet(t->size);
+
+  /* Only the varying fields change between packets of the same template. */
+  if (packet != last_buffer || t != last_template)
+  {
+    memcpy(packet, t->base, t->size);
+    last_buffer = packet;
+    last_template = t;
+  }
+
+  patchTemplate(t, packet, co->ip.daddr, NULL);
+  *size = t->size;
+}
+
+/* Writes a field, adding its change to the checksums covering it ('deltas' is NULL
+   if no checksum is updated incrementally). */
+static inline void writeField(const template_field_t *f, void *buffer, const void *value,
+                              size_t width, uint32_t *deltas)
+{
+  uint32_t d;
+  unsigned mask;
+
+  if (deltas != NULL && f->cksums)
+  {
+    d = cksumDelta(buffer + f->offset, value, width, f->offset & 1);
+    for (mask = f->cksums; mask; mask &= mask - 1)
+      deltas[__builtin_ctz(mask)] += d;
+  }
+
+  memcpy(buffer + f->offset, value, width);
+}
+
+/* Sums a checksum region. Header regions are a few bytes, so this is cheaper than
+   calling cksum(). Regions with a payload are left to it. */
+static inline uint16_t sumRegion(const uint8_t *p, size_t length)
+{
+  uint64_t sum = 0;
+  uint32_t w32;
+  uint16_t w16;
+
+  if (length > INLINE_SUM_LENGTH)
+    return cksum((void *)p, length);
+
+  for (; length >= 4; length -= 4, p += 4)
+  {
+    memcpy(&w32, p, 4);
+    sum += w32;
+  }
+
+  if (length >= 2)
+  {
+    memcpy(&w16, p, 2);
+    sum += w16;
+    p += 2;
+    length -= 2;
+  }
+
+  if (length)
+    sum += *p;
+
+  return ~foldSum(sum);
+}
+
+/* Writes the values on the fields. 'daddr' is in host order. */
+static inline void patchFields(const template_t *t, void *buffer, uint32_t daddr,
+                               const uint32_t *values, uint32_t *deltas)
+{
+  const template_field_t *f, *end;
+  uint32_t v, v32;
+  uint16_t v16;
+  uint8_t v8;
+
+  for (f = t->fields, end = f + t->num_fields; f < end; f++)
+  {
+    v = f->draw == DRAW_DADDR ? daddr : values[f->draw];
+
+    switch (f->type)
+    {
+      case FIELD_BE32:   v32 = htonl(v); writeField(f, buffer, &v32, 4, deltas); break;
+      case FIELD_HOST32: writeField(f, buffer, &v, 4, deltas); break;
+      case FIELD_BE16:   v16 = htons(v); writeField(f, buffer, &v16, 2, deltas); break;
+      case FIELD_HOST16: v16 = v; writeField(f, buffer, &v16, 2, deltas); break;
+      case FIELD_U8:     v8 = v; writeField(f, buffer, &v8, 1, deltas); break;
+      case FIELD_BITS:
+        v8 = (*(uint8_t *)(buffer + f->offset) & ~f->mask) | ((v << f->shift) & f->mask);
+        writeField(f, buffer, &v8, 1, deltas);
+        break;
+    }
+  }
+}
+
+/* Writes new values on the fields and recalculates the checksums.
+   Values come from 'values', or from the random ring if it's NULL: All of them
+   are taken at once (see takeRandom()), in the order the module draws them. */
+static void patchTemplate(const template_t *t, void *buffer, in_addr_t daddr, const uint32_t *values)
+{
+  const template_cksum_t *c;
+  uint32_t deltas[MAX_CKSUMS] = {};
+  uint32_t d;
+  uint16_t v16, old;
+  unsigned i, mask;
+
+  if (values == NULL)
+    values = takeRandom(t->num_draws);
+
+  /* NOTE: Two copies of the loop: Without incremental checksums, the fields are
+           just stored. */
+  if (t->incremental)
+    patchFields(t, buffer, ntohl(daddr), values, deltas);
+  else
+    patchFields(t, buffer, ntohl(daddr), values, NULL);
+
+  for (i = 0, c = t->cksums; i < t->num_cksums; i++, c++)
+  {
+    memcpy(&old, buffer + c->offset, 2);
+
+    if (c->incremental)
+    {
+      /* Deltas are summed as words starting on even offsets. On regions
+         starting on odd ones, their bytes are swapped (RFC 1071, 2(B)). */
+      d = foldSum(deltas[i]);
+      if (c->start & 1)
+        d = ((d >> 8) | (d << 8)) & 0xffff;
+
+      v16 = updateCksum(old, d);
+    }
+    else
+    {
+      v16 = 0;
+      memcpy(buffer + c->offset, &v16, 2);
+      v16 = sumRegion(buffer + c->start, c->length);
+    }
+
+    memcpy(buffer + c->offset, &v16, 2);
+
+    if (c->outer)
+    {
+      d = cksumDelta(&old, buffer + c->offset, 2, c->offset & 1);
+      for (mask = c->outer; mask; mask &= mask - 1)
+        deltas[__builtin_ctz(mask)] += d;
+    }
+  }
+}
+
+static uint32_t recordRandom(void)
+{
+  uint32_t v;
+
+  v = (recording->draws < script_len) ? script[recording->draws] : __RANDOM();
+
+  if (recording->draws < MAX_DRAWS)
+    recording->values[recording->draws] = v;
+  recording->draws++;
+
+  return v;
+}
+
+/* Calls the module with RANDOM() returning the 'count' values from 'values' (random
+   values after them) and 'daddr' as destination address. */
+static int buildSample(modules_table_t *ptbl, struct config_options *co, in_addr_t daddr,
+                       const uint32_t *values, unsigned count, sample_t *sample)
+{
+  sample->draws = 0;
+  script = values;
+  script_len = count;
+  recording = sample;
+
+  co->ip.daddr = daddr;
+
+  random_hook = recordRandom;
+  ptbl->func(co, &sample->size);
+  random_hook = NULL;
+
+  if (sample->draws > MAX_DRAWS || sample->size > UINT16_MAX)
+    return FALSE;
+
+  if ((sample->data = malloc(sample->size)) == NULL)
+    return FALSE;
+  memcpy(sample->data, packet, sample->size);
+
+  return TRUE;
+}
+
+static template_t *compileTemplate(modules_table_t *ptbl, struct config_options *co)
+{
+  sample_t *samples;
+  template_t *t;
+  uint8_t *explained;
+  unsigned i, n, num_samples;
+  in_addr_t daddr;
+  uint32_t values[MAX_DRAWS];
+  size_t j;
+  int ok = FALSE;
+
+  /* samples[0]: reference; samples[1..n]: value i changed; samples[n+1]: daddr changed;
+     samples[n+2]: verification. */
+  samples = calloc(MAX_DRAWS + 3, sizeof(sample_t));
+  t = calloc(1, sizeof(template_t));
+  explained = NULL;
+  num_samples = 0;
+
+  if (samples == NULL || t == NULL)
+    goto done;
+
+  daddr = __RANDOM();
+  if (!buildSample(ptbl, co, daddr, NULL, 0, &samples[0]))
+    goto done;
+  num_samples = 1;
+
+  n = samples[0].draws;
+  t->num_draws = n;
+  t->size = samples[0].size;
+
+  if ((explained = calloc(t->size, 1)) == NULL)
+    goto done;
+
+  /* Where each value goes. */
+  for (i = 0; i < n; i++)
+  {
+    memcpy(values, samples[0].values, n * sizeof(uint32_t));
+    values[i] = ~values[i];   /* NOTE: All bytes are different. */
+
+    if (!buildSample(ptbl, co, daddr, values, n, &samples[num_samples]))
+      goto done;
+    num_samples++;
+
+    if (!findFields(t, &samples[0], &samples[num_samples - 1], i,
+                    samples[0].values[i], values[i], explained))
+      goto done;
+  }
+
+  /* Where the destination address goes. */
+  if (!buildSample(ptbl, co, ~daddr, samples[0].values, n, &samples[num_samples]))
+    goto done;
+  num_samples++;
+
+  if (!findFields(t, &samples[0], &samples[num_samples - 1], DRAW_DADDR, ntohl(daddr), ntohl(~daddr), explained))
+    goto done;
+
+  /* Bit fields are checked against all samples, so they aren't mistaken for checksums. */
+  for (i = 0; i < n; i++)
+    if (!findBitFields(t, samples, num_samples, i, samples[0].values[i], ~samples[0].values[i], explained))
+      goto done;
+
+  qsort(t->fields, t->num_fields, sizeof(template_field_t), compareFields);
+
+  /* Any other bit changed must be part of a checksum. */
+  for (j = 0; j < t->size; j++)
+  {
+    if (explained[j] == 0xff)
+      continue;
+
+    for (i = 1; i < num_samples; i++)
+      if ((samples[i].data[j] ^ samples[0].data[j]) & ~explained[j])
+        break;
+
+    if (i == num_samples)
+      continue;
+
+    /* Try the checksum word starting on this byte, then on the previous one. */
+    if (!findCksum(t, samples, num_samples, j, explained) &&
+        (j == 0 || !findCksum(t, samples, num_samples, j - 1, explained)))
+      goto done;
+  }
+
+  if ((t->base = malloc(t->size)) == NULL)
+    goto done;
+  memcpy(t->base, samples[0].data, t->size);
+
+  setIncremental(t, t->base, explained);
+
+  /* Checks the template against packets built by the module. */
+  for (i = 0; i < VERIFY_SAMPLES; i++)
+  {
+    sample_t *s = &samples[num_samples];
+
+    free(s->data);
+    if (!buildSample(ptbl, co, __RANDOM(), NULL, 0, s) ||
+        s->size != t->size || s->draws != n)
+      goto done;
+
+    memcpy(packet, t->base, t->size);
+    patchTemplate(t, packet, co->ip.daddr, s->values);
+
+    if (memcmp(packet, s->data, t->size))
+      goto done;
+  }
+
+  ok = co->force_template || !isSlower(t, ptbl, co);
+
+done:
+  if (samples != NULL)
+    for (i = 0; i <= num_samples; i++)
+      free(samples[i].data);
+  free(samples);
+  free(explained);
+
+  if (!ok && t != NULL)
+  {
+    free(t->base);
+    free(t);
+    t = NULL;
+  }
+
+  return t;
+}
+
+/* Stores 'v' as 'type' on 'p'. Returns the number of bytes. */
+static size_t storeValue(uint8_t *p, int type, uint32_t v)
+{
+  uint32_t v32;
+  uint16_t v16;
+
+  switch (type)
+  {
+    case FIELD_BE32:   v32 = htonl(v); memcpy(p, &v32, 4); return 4;
+    case FIELD_HOST32: memcpy(p, &v, 4); return 4;
+    case FIELD_BE16:   v16 = htons(v); memcpy(p, &v16, 2); return 2;
+    case FIELD_HOST16: v16 = v; memcpy(p, &v16, 2); return 2;
+  }
+
+  *p = v;
+  return 1;
+}
+
+/* Finds the fields holding value 'v0' on sample 'a' and 'v1' on sample 'b', the only
+   difference between them. Wider fields are tried first. */
+static int findFields(template_t *t, const sample_t *a, const sample_t *b, uint16_t draw,
+                      uint32_t v0, uint32_t v1, uint8_t *explained)
+{
+  uint8_t p0[4], p1[4];
+  size_t width, off, k;
+  int type;
+
+  if (a->size != b->size || (draw != DRAW_DADDR && a->draws != b->draws))
+    return FALSE;
+
+  for (type = FIELD_BE32; type <= FIELD_U8; type++)
+  {
+    width = storeValue(p0, type, v0);
+    storeValue(p1, type, v1);
+
+    for (off = 0; off + width <= a->size; off++)
+    {
+      if (memcmp(a->data + off, p0, width) || memcmp(b->data + off, p1, width))
+        continue;
+
+      for (k = 0; k < width; k++)
+        if (explained[off + k])
+          break;
+      if (k < width)
+        continue;
+
+      if (t->num_fields == MAX_FIELDS)
+        return FALSE;
+
+      t->fields[t->num_fields].offset = off;
+      t->fields[t->num_fields].draw = draw;
+      t->fields[t->num_fields].type = type;
+      t->num_fields++;
+
+      memset(explained + off, 0xff, width);
+      off += width - 1;
+    }
+  }
+
+  return TRUE;
+}
+
+/* Finds bit fields (ex: 'qrv:3') holding value 'v0' on samples[0] and 'v1' on samples[1 + draw].
+   The bits must not change on any other sample. */
+static int findBitFields(template_t *t, const sample_t *samples, unsigned num_samples, unsigned draw,
+                         uint32_t v0, uint32_t v1, uint8_t *explained)
+{
+  const uint8_t *a = samples[0].data, *b = samples[1 + draw].data;
+  unsigned shift, i;
+  uint8_t mask;
+  size_t off;
+
+  for (off = 0; off < samples[0].size; off++)
+  {
+    if ((mask = (a[off] ^ b[off]) & ~explained[off]) == 0)
+      continue;
+
+    /* Contiguous bits only. */
+    shift = __builtin_ctz(mask);
+    if (((mask >> shift) & ((mask >> shift) + 1)) != 0)
+      continue;
+
+    if (((a[off] & mask) >> shift) != (v0 & (mask >> shift)) ||
+        ((b[off] & mask) >> shift) != (v1 & (mask >> shift)))
+      continue;
+
+    for (i = 1; i < num_samples; i++)
+      if (i != 1 + draw && ((samples[i].data[off] ^ a[off]) & mask))
+        break;
+    if (i < num_samples)
+      continue;
+
+    if (t->num_fields == MAX_FIELDS)
+      return FALSE;
+
+    t->fields[t->num_fields].offset = off;
+    t->fields[t->num_fields].draw = draw;
+    t->fields[t->num_fields].type = FIELD_BITS;
+    t->fields[t->num_fields].mask = mask;
+    t->fields[t->num_fields].shift = shift;
+    t->num_fields++;
+
+    explained[off] |= mask;
+  }
+
+  return TRUE;
+}
+
+/* Sorts fields by draw, then by offset. */
+static int compareFields(const void *a, const void *b)
+{
+  const template_field_t *fa = a, *fb = b;
+
+  if (fa->draw != fb->draw)
+    return fa->draw - fb->draw;
+  return fa->offset - fb->offset;
+}
+
+/* Sum of the 16 bits words of 'data', starting at 'parity', as cksum() sees them. */
+static uint64_t *prefixSums(const sample_t *s, unsigned parity)
+{
+  uint64_t *sums;
+  size_t i, n;
+  uint16_t w;
+
+  n = (s->size - parity + 1) / 2;
+  if ((sums = malloc((n + 1) * sizeof(uint64_t))) == NULL)
+    return NULL;
+
+  sums[0] = 0;
+  for (i = 0; i < n; i++)
+  {
+    w = 0;
+    memcpy(&w, s->data + parity + 2 * i, (parity + 2 * i + 1 < s->size) ? 2 : 1);
+    sums[i + 1] = sums[i] + w;
+  }
+
+  return sums;
+}
+
+/* Folds a sum to 16 bits one's complement. */
+static uint16_t foldSum(uint64_t sum)
+{
+  while (sum >> 16)
+    sum = (sum & 0xffff) + (sum >> 16);
+  return sum;
+}
+
+/* Finds the smallest region holding the checksum word at 'offset' that is valid
+   on all samples. */
+static int findCksum(template_t *t, const sample_t *samples, unsigned num_samples, uint16_t offset,
+                     uint8_t *explained)
+{
+  uint64_t *sums[MAX_DRAWS + 2] = {};
+  size_t start, end, best_start = 0, best_len = 0, size = t->size;
+  unsigned parity = offset & 1, i;
+  uint64_t sum;
+
+  if ((size_t)offset + 2 > size || t->num_cksums == MAX_CKSUMS)
+    return FALSE;
+
+  for (i = 0; i < num_samples; i++)
+    if ((sums[i] = prefixSums(&samples[i], parity)) == NULL)
+      goto done;
+
+  for (start = offset + 2; start >= 2 + parity; )
+  {
+    start -= 2;
+
+    for (end = offset + 2; end <= size; end++)
+    {
+      if (best_len && end - start >= best_len)
+        break;
+
+      for (i = 0; i < num_samples; i++)
+      {
+        size_t w0 = (start - parity) / 2, w1 = (end - parity) / 2;
+
+        sum = sums[i][w1] - sums[i][w0];
+
+        /* Odd regions end with a lone byte. */
+        if ((end - start) & 1)
+          sum += samples[i].data[end - 1];
+
+        if (foldSum(sum) != 0xffff)
+          break;
+      }
+
+      if (i == num_samples)
+      {
+        best_start = start;
+        best_len = end - start;
+        break;
+      }
+    }
+  }
+
+done:
+  for (i = 0; i < num_samples; i++)
+    free(sums[i]);
+
+  if (!best_len)
+    return FALSE;
+
+  /* Inner regions first: Outer checksums cover the inner ones. */
+  for (i = t->num_cksums; i > 0 && t->cksums[i - 1].length > best_len; i--)
+    t->cksums[i] = t->cksums[i - 1];
+
+  t->cksums[i].offset = offset;
+  t->cksums[i].start = best_start;
+  t->cksums[i].length = best_len;
+  t->num_cksums++;
+
+  explained[offset] = explained[offset + 1] = 0xff;
+
+  return TRUE;
+}
+
+/* Tells if [offset, offset + length) is inside, outside or across checksum 'c' region. */
+enum { REGION_OUTSIDE, REGION_INSIDE, REGION_ACROSS };
+
+static int regionOf(const template_cksum_t *c, size_t offset, size_t length)
+{
+  if (offset + length <= c->start || offset >= (size_t)c->start + c->length)
+    return REGION_OUTSIDE;
+  if (offset >= c->start && offset + length <= (size_t)c->start + c->length)
+    return REGION_INSIDE;
+  return REGION_ACROSS;
+}
+
+/* Chooses the checksums that can be updated incrementally (see the note at the top)
+   and which of them cover each field and checksum word. 'explained' holds the bits
+   of 'base' that aren't constant. */
+static void setIncremental(template_t *t, const uint8_t *base, const uint8_t *explained)
+{
+  template_cksum_t *c, *o;
+  template_field_t *f;
+  unsigned i, k, updates;
+  int where;
+  size_t j;
+
+  for (i = 0, c = t->cksums; i < t->num_cksums; i++, c++)
+  {
+    c->incremental = FALSE;
+
+    for (j = c->start; j < (size_t)c->start + c->length; j++)
+      if (base[j] & ~explained[j])
+        break;
+    if (j == (size_t)c->start + c->length)
+      continue;
+
+    for (updates = 0, k = 0, f = t->fields; k < t->num_fields; k++, f++)
+    {
+      where = regionOf(c, f->offset, fieldWidth(f->type));
+      if (where == REGION_ACROSS)
+        break;
+      updates += where == REGION_INSIDE;
+    }
+    if (k < t->num_fields)
+      continue;
+
+    /* Checksum words inside must be calculated before this one. */
+    for (k = 0, o = t->cksums; k < t->num_cksums; k++, o++)
+    {
+      if (k == i)
+        continue;
+
+      where = regionOf(c, o->offset, 2);
+      if (where == REGION_ACROSS || (k > i && where == REGION_INSIDE))
+        break;
+      updates += where == REGION_INSIDE;
+    }
+    if (k < t->num_cksums)
+      continue;
+
+    /* Summing the region again is faster with more than one field per
+       FIELD_CKSUM_COST bytes. */
+    if (updates * FIELD_CKSUM_COST >= c->length)
+      continue;
+
+    c->incremental = TRUE;
+    t->incremental = TRUE;
+  }
+
+  for (k = 0, f = t->fields; k < t->num_fields; k++, f++)
+    for (f->cksums = 0, i = 0, c = t->cksums; i < t->num_cksums; i++, c++)
+      if (c->incremental && regionOf(c, f->offset, fieldWidth(f->type)) == REGION_INSIDE)
+        f->cksums |= 1U << i;
+
+  /* Only outer checksums come after (and can include) a checksum word. */
+  for (k = 0, o = t->cksums; k < t->num_cksums; k++, o++)
+    for (o->outer = 0, i = k + 1, c = o + 1; i < t->num_cksums; i++, c++)
+      if (c->incremental && regionOf(c, o->offset, 2) == REGION_INSIDE)
+        o->outer |= 1U << i;
+}
+
+static uint64_t nanoseconds(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Tells if patching the template isn't faster than calling the module (best of a
+   few rounds). */
+static int isSlower(const template_t *t, modules_table_t *ptbl, struct config_options *co)
+{
+  uint64_t t0, module_time = UINT64_MAX, template_time = UINT64_MAX;
+  unsigned i, j;
+  size_t size;
+
+  for (i = 0; i < TIMING_ROUNDS; i++)
+  {
+    t0 = nanoseconds();
+    for (j = 0; j < TIMING_PACKETS; j++)
+      ptbl->func(co, &size);
+    t0 = nanoseconds() - t0;
+    if (t0 < module_time)
+      module_time = t0;
+
+    memcpy(packet, t->base, t->size);
+
+    t0 = nanoseconds();
+    for (j = 0; j < TIMING_PACKETS; j++)
+      patchTemplate(t, packet, co->ip.daddr, NULL);
+    t0 = nanoseconds() - t0;
+    if (t0 < template_time)
+      template_time = t0;
+  }
+
+  return template_time >= module_time;
+}
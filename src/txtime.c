@@ -0,0 +1,183 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <common.h>
+#include <poll.h>
+#include <linux/net_tstamp.h>
+#include <linux/errqueue.h>
+
+/* NOTE: Transmit time (--txtime).
+
+   The rate control gives each packet its departure time (see pace()) and the
+   raw backend attaches it with SCM_TXTIME, so the qdisc (etf, or fq) holds it
+   until then, instead of the worker sleeping. The kernel reports when each
+   packet actually left (software transmit timestamps, keyed by SOF_TIMESTAMPING_OPT_ID,
+   which counts the packets sent on the socket) and the packets the qdisc dropped
+   for missing their time. Scheduled times are kept on a ring, in sending order,
+   to find the deviation of each departure.
+
+   Timestamps are on CLOCK_REALTIME: The offset to the --txtime clock is taken
+   once (both follow the same NTP adjustments). */
+
+#define TXTIME_RING     65536       /* packets on their way (power of 2)   */
+#define TXTIME_DRAIN_MS 100         /* waiting for the last departures     */
+
+static __thread uint64_t *scheduled = NULL;
+static __thread uint32_t sent, reported;
+static __thread int64_t realtime_offset;    /* --txtime clock - CLOCK_REALTIME */
+
+static uint64_t clockNs(clockid_t clock)
+{
+  struct timespec ts;
+
+  clock_gettime(clock, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+clockid_t txtimeClock(const struct config_options * const __restrict__ co)
+{
+  /* NOTE: etf only takes CLOCK_TAI. fq only takes CLOCK_MONOTONIC. */
+  return co->txtime == TXTIME_FQ ? CLOCK_MONOTONIC : CLOCK_TAI;
+}
+
+int initTxtime(socket_t fd, const struct config_options * const __restrict__ co)
+{
+  struct sock_txtime st = {};
+  int flags;
+
+  assert(co != NULL);
+
+  st.clockid = txtimeClock(co);
+  st.flags = SOF_TXTIME_REPORT_ERRORS;
+
+  if (setsockopt(fd, SOL_SOCKET, SO_TXTIME, &st, sizeof(st)) == -1)
+  {
+    perror("error setting transmit time (SO_TXTIME)");
+    return FALSE;
+  }
+
+  flags = SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE |
+          SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+
+  if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == -1)
+  {
+    perror("error setting transmit timestamps (SO_TIMESTAMPING)");
+    return FALSE;
+  }
+
+  if ((scheduled = malloc(TXTIME_RING * sizeof(uint64_t))) == NULL)
+  {
+    ERROR("Error allocating transmit times");
+    return FALSE;
+  }
+
+  sent = reported = 0;
+  realtime_offset = clockNs(st.clockid) - clockNs(CLOCK_REALTIME);
+
+  return TRUE;
+}
+
+void closeTxtime(void)
+{
+  free(scheduled);
+  scheduled = NULL;
+}
+
+void setTxtime(struct msghdr *msg, void *control, uint64_t txtime)
+{
+  struct cmsghdr *cmsg;
+
+  msg->msg_control = control;
+  msg->msg_controllen = TXTIME_CONTROL_SIZE;
+
+  cmsg = CMSG_FIRSTHDR(msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_TXTIME;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(uint64_t));
+  memcpy(CMSG_DATA(cmsg), &txtime, sizeof(uint64_t));
+
+  scheduled[sent++ & (TXTIME_RING - 1)] = txtime;
+}
+
+/* Adds a departure 'deviation' nanoseconds off schedule to the worker's statistics. */
+static void countDeparture(int64_t deviation)
+{
+  uint64_t d;
+
+  d = deviation < 0 ? -deviation : deviation;
+
+  statsAdd(&worker_stats->departures, 1);
+  statsAdd(&worker_stats->departure_ns, deviation);
+  statsAdd(&worker_stats->departure_abs_ns, d);
+  if (d > worker_stats->departure_max_ns)
+    __atomic_store_n(&worker_stats->departure_max_ns, d, __ATOMIC_RELAXED);
+}
+
+void readDepartures(socket_t fd, int wait)
+{
+  char control[512];
+  struct msghdr msg;
+  struct cmsghdr *cmsg;
+  struct sock_extended_err *err;
+  struct scm_timestamping *tss;
+  struct pollfd pfd = { fd, 0, 0 };
+  uint64_t departure;
+
+  if (scheduled == NULL || worker_stats == NULL)
+    return;
+
+  for (;;)
+  {
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == -1)
+    {
+      /* NOTE: POLLERR tells there's something on the error queue. */
+      if (wait && (errno == EAGAIN || errno == EINTR) && reported != sent &&
+          poll(&pfd, 1, TXTIME_DRAIN_MS) > 0)
+        continue;
+      return;
+    }
+
+    err = NULL;
+    tss = NULL;
+
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg))
+      if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPING)
+        tss = (struct scm_timestamping *)CMSG_DATA(cmsg);
+      else if (cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_RECVERR)
+        err = (struct sock_extended_err *)CMSG_DATA(cmsg);
+
+    if (err == NULL)
+      continue;
+
+    reported++;
+
+    if (err->ee_origin == SO_EE_ORIGIN_TXTIME)
+      statsAdd(&worker_stats->txtime_dropped, 1);
+    else if (err->ee_origin == SO_EE_ORIGIN_TIMESTAMPING && tss != NULL &&
+             sent - err->ee_data - 1 < TXTIME_RING)
+    {
+      departure = tss->ts[0].tv_sec * 1000000000ULL + tss->ts[0].tv_nsec + realtime_offset;
+      countDeparture(departure - scheduled[err->ee_data & (TXTIME_RING - 1)]);
+    }
+  }
+}
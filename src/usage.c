@@ -36,6 +36,7 @@ void usage(void)
   puts("\nUsage: t50 <host> [/CIDR] [options]");
 
   general_help();
+  output_help();
   gre_help();
   tcp_udp_dccp_help();
   ip_help();
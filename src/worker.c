@@ -0,0 +1,542 @@
+/*
+ *  T50 - Experimental Mixed Packet Injector
+ *
+ *  Copyright (C) 2010 - 2014 - T50 developers
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <common.h>
+#include <sched.h>
+
+static worker_t *workers = NULL;
+static unsigned num_workers = 0;
+
+/* Set when a worker fails, so the others (in flood mode) stop too. */
+static volatile int stop_workers = FALSE;
+
+static void *workerThread(void *);
+static int   workerLoop(worker_t *);
+static int   poolLoop(worker_t *);
+static int   replayLoop(worker_t *);
+static int   streamLoop(worker_t *);
+static unsigned nextStream(worker_t *);
+static int   shareStreams(worker_t *);
+static void  pinWorker(worker_t *);
+static void  assignCPUs(void);
+
+int initWorkers(const struct config_options * const __restrict__ co)
+{
+  threshold_t share, remainder, threshold;
+  unsigned i;
+  int flood;
+
+  assert(co != NULL);
+
+  num_workers = co->threads;
+
+#ifdef  __HAVE_TURBO__
+  /* NOTE: Turbo used to fork one child. Now it's the same as --threads 2. */
+  if (co->turbo && num_workers < 2)
+    num_workers = 2;
+#endif  /* __HAVE_TURBO__ */
+
+  /* No idle workers (with streams, on the biggest one). */
+  flood = num_streams ? FALSE : co->flood;
+  threshold = num_streams ? 0 : co->threshold;
+
+  for (i = 0; i < num_streams; i++)
+  {
+    flood |= streams[i].co.flood;
+    if (streams[i].co.threshold > threshold)
+      threshold = streams[i].co.threshold;
+  }
+
+  if (!flood && threshold < (threshold_t)num_workers)
+    num_workers = threshold;
+
+  if (posix_memalign((void **)&workers, CACHE_LINE_SIZE, num_workers * sizeof(worker_t)))
+  {
+    ERROR("Error allocating workers");
+    return FALSE;
+  }
+
+  /* Every worker gets an equal share of the threshold. The first ones get the extra packets. */
+  share = co->threshold / num_workers;
+  remainder = co->threshold % num_workers;
+
+  for (i = 0; i < num_workers; i++)
+  {
+    memset(&workers[i], 0, sizeof(worker_t));
+    workers[i].id = i;
+    workers[i].cpu = -1;
+    workers[i].co = *co;
+    workers[i].co.threshold = share + ((threshold_t)i < remainder);
+
+    /* NOTE: Each AF_XDP socket must be bound to its own queue. */
+    workers[i].co.queue = co->queue + i;
+
+    initPacer(&workers[i].pacer, co, num_workers);
+
+    if (num_streams && !shareStreams(&workers[i]))
+      return FALSE;
+  }
+
+  if (num_workers > 1)
+  {
+    assignCPUs();
+
+    /* Setting the priority to a highly favorable scheduling value.
+       NOTE: Threads inherit it from the creator. Only root can do it (some backends don't need root). */
+    if (setpriority(PRIO_PROCESS, 0, -15) == -1 && getuid() == 0)
+    {
+      perror("Error setting process priority. Exiting...");
+      return FALSE;
+    }
+  }
+
+  /* The first worker runs on the calling thread, so socket errors show before the launch. */
+  pinWorker(&workers[0]);
+  return createSocket(&workers[0].co);
+}
+
+int runWorkers(const struct cidr * const cidr)
+{
+  uint64_t start;
+  unsigned i, j;
+  int status;
+
+  assert(cidr != NULL);
+
+  /* The cidr is shared by all workers. It's read only. Each one gets its own hosts. */
+  for (i = 0; i < num_workers; i++)
+  {
+    initDestinations(&workers[i].dest, cidr, workers[i].co.dest_order,
+                     workers[i].co.dest_shards, i, num_workers);
+
+    /* Streams have their own cidr (and shards of it). */
+    for (j = 0; j < num_streams; j++)
+      initDestinations(&workers[i].streams[j].dest, &streams[j].cidr, workers[i].streams[j].co.dest_order,
+                       workers[i].streams[j].co.dest_shards, i, num_workers);
+  }
+
+  if (!startStats(&workers[0].co, &workers[0].stats, sizeof(worker_t), num_workers))
+    return FALSE;
+
+  start = pacingClock();
+
+  for (i = 1; i < num_workers; i++)
+    if ((errno = pthread_create(&workers[i].thread, NULL, workerThread, &workers[i])) != 0)
+    {
+      perror("Error creating worker thread. Exiting...");
+      stop_workers = TRUE;
+      num_workers = i;
+      break;
+    }
+
+  workerThread(&workers[0]);
+
+  status = !stop_workers;
+  for (i = 1; i < num_workers; i++)
+  {
+    pthread_join(workers[i].thread, NULL);
+    status &= workers[i].status;
+  }
+
+  status &= workers[0].status;
+
+  stopStats();
+  printSummary(&workers[0].co, pacingClock() - start);
+
+  for (i = 0; i < num_workers; i++)
+    free(workers[i].streams);
+
+  free(workers);
+  workers = NULL;
+
+  return status;
+}
+
+static void *workerThread(void *arg)
+{
+  worker_t *w = arg;
+  uint64_t cpu;
+
+  worker_stats = &w->stats;
+  cpu = threadCpuTime();
+
+  /* Packets carry the whole payload, unless --sizes draws their sizes. */
+  setPayloadSize(payload_length);
+
+  /* The first worker is already pinned and has its socket. */
+  if (w->id != 0)
+  {
+    pinWorker(w);
+
+    if (!createSocket(&w->co))
+      goto error;
+  }
+
+  if (!(replay_count ? replayLoop(w) : pool_count ? poolLoop(w) :
+        num_streams ? streamLoop(w) : workerLoop(w)))
+    goto error;
+
+  closeSocket();
+  statsAdd(&w->stats.cpu_ns, threadCpuTime() - cpu);
+  w->status = TRUE;
+  return NULL;
+
+error:
+  closeSocket();
+  statsAdd(&w->stats.cpu_ns, threadCpuTime() - cpu);
+  stop_workers = TRUE;
+  w->status = FALSE;
+  return NULL;
+}
+
+/* Builds and sends this worker's share of packets. */
+static int workerLoop(worker_t *w)
+{
+  struct config_options *co = &w->co;
+  modules_table_t *ptbl;      /* Pointer to modules table */
+  uint8_t proto;              /* Used on main loop. */
+  size_t n;                   /* place on the --protocol-mix schedule */
+
+  /* Selects the initial protocol to use. */
+  proto = co->ip.protocol;
+  ptbl = mod_table;
+  if (proto != IPPROTO_T50)
+    ptbl += co->ip.protoname;
+
+  /* Each worker starts at its own place, so together they follow the mix. */
+  n = mix_length ? (size_t)w->id * mix_length / num_workers : 0;
+
+  /* Preallocate packet buffer. */
+  alloc_packet(INITIAL_PACKET_SIZE);
+
+  /* Execute if flood or while threshold greater than 0. */
+  while (co->flood || (co->threshold-- > 0))
+  {
+    /* Holds the actual packet size after module function call. */
+    size_t size;
+
+    if (stop_workers)
+      return FALSE;
+
+    /* If protocol is 'T50', then get the next one on the schedule. */
+    if (proto == IPPROTO_T50)
+    {
+      ptbl = mod_table + mix_schedule[n];
+      if (++n == mix_length)
+        n = 0;
+    }
+
+    /* Set the destination IP address, in --dest-order. */
+    co->ip.daddr = nextDestination(&w->dest);
+
+    /* Calls the 'module' function and sends the packet. */
+    if (!preparePacket())
+      return FALSE;
+
+    co->ip.protocol = ptbl->protocol_id;
+    buildPacket(ptbl, co, &size);
+
+    if (w->pacer.active && !pace(&w->pacer, size))
+      return FALSE;
+
+    if (!sendPacket(packet, size, co))
+      return FALSE;
+
+    statsAdd(&w->stats.packets, 1);
+    statsAdd(&w->stats.bytes, size);
+    statsAdd(&w->stats.modules[ptbl - mod_table], 1);
+  }
+
+  /* Send the last, partial, batch. */
+  return flushPackets();
+}
+
+/* Sends this worker's share of packets from the pool, starting at its own place. */
+static int poolLoop(worker_t *w)
+{
+  struct config_options *co = &w->co;
+  const pool_entry_t *e;
+  size_t n;
+
+  n = (size_t)w->id * pool_count / num_workers;
+
+  while (co->flood || (co->threshold-- > 0))
+  {
+    if (stop_workers)
+      return FALSE;
+
+    e = &pool_entries[n];
+    co->ip.daddr = e->daddr;
+
+    if (w->pacer.active && !pace(&w->pacer, e->size))
+      return FALSE;
+
+    if (!sendPacket(pool_arena + e->offset, e->size, co))
+      return FALSE;
+
+    statsAdd(&w->stats.packets, 1);
+    statsAdd(&w->stats.bytes, e->size);
+    statsAdd(&w->stats.modules[e->module], 1);
+
+    if (++n == pool_count)
+      n = 0;
+  }
+
+  return flushPackets();
+}
+
+/* Sends this worker's share of the --replay packets: One every 'num_workers',
+   so each one keeps its place (and time) on the file. */
+static int replayLoop(worker_t *w)
+{
+  struct config_options *co = &w->co;
+  const replay_entry_t *e;
+  const void *p;
+  uint64_t offset;            /* time of the passes already done */
+  size_t n;
+
+  n = w->id % replay_count;
+  offset = (w->id / replay_count) * replay_period;
+
+  while (co->flood || (co->threshold-- > 0))
+  {
+    if (stop_workers)
+      return FALSE;
+
+    e = &replay_entries[n];
+
+    if (w->pacer.active &&
+        !(co->replay_speed ? paceAt(&w->pacer, offset + e->time) : pace(&w->pacer, e->size)))
+      return FALSE;
+
+    /* Same destination address choice as built packets. */
+    if (replay_rewrite)
+    {
+      co->ip.daddr = nextDestination(&w->dest);
+
+      if (!preparePacket())
+        return FALSE;
+
+      rewritePacket(e, co->ip.daddr);
+      p = packet;
+    }
+    else
+    {
+      co->ip.daddr = e->daddr;
+      p = replay_data + e->offset;
+    }
+
+    if (!sendPacket(p, e->size, co))
+      return FALSE;
+
+    statsAdd(&w->stats.packets, 1);
+    statsAdd(&w->stats.bytes, e->size);
+    if (e->module < STATS_MODULES)
+      statsAdd(&w->stats.modules[e->module], 1);
+
+    for (n += num_workers; n >= replay_count; n -= replay_count)
+      offset += replay_period;
+  }
+
+  return flushPackets();
+}
+
+/* Builds and sends this worker's share of every stream, the one due first each time. */
+static int streamLoop(worker_t *w)
+{
+  worker_stream_t *s;
+  modules_table_t *ptbl;
+  unsigned i, active;
+  uint64_t start;
+  size_t size;
+
+  alloc_packet(INITIAL_PACKET_SIZE);
+  start = pacingClock();
+
+  for (i = active = 0; i < num_streams; i++)
+    active += !w->streams[i].done;
+
+  while (active)
+  {
+    if (stop_workers)
+      return FALSE;
+
+    i = nextStream(w);
+    s = &w->streams[i];
+
+    /* Its sizes, templates and payload. */
+    current_stream = i;
+    setPayloadSize(streams[i].payload);
+
+    ptbl = mod_table;
+    if (s->proto != IPPROTO_T50)
+      ptbl += s->co.ip.protoname;
+    else
+    {
+      ptbl += mix_schedule[s->mix];
+      if (++s->mix == mix_length)
+        s->mix = 0;
+    }
+
+    s->co.ip.daddr = nextDestination(&s->dest);
+
+    if (!preparePacket())
+      return FALSE;
+
+    s->co.ip.protocol = ptbl->protocol_id;
+    buildPacket(ptbl, &s->co, &size);
+
+    if (s->pacer.active && !pace(&s->pacer, size))
+      return FALSE;
+
+    if (!sendPacket(packet, size, &s->co))
+      return FALSE;
+
+    statsAdd(&w->stats.packets, 1);
+    statsAdd(&w->stats.bytes, size);
+    statsAdd(&w->stats.modules[ptbl - mod_table], 1);
+    statsAdd(&w->stats.stream_packets[i], 1);
+    statsAdd(&w->stats.stream_bytes[i], size);
+
+    if (!s->co.flood && --s->co.threshold == 0)
+    {
+      s->done = TRUE;
+      active--;
+      statsAdd(&w->stats.stream_ns[i], pacingClock() - start);
+    }
+  }
+
+  return flushPackets();
+}
+
+/* The stream to send next: The rated one due first, unless it isn't due yet.
+   Streams without rates fill those gaps, taking turns (all the time, if no
+   stream is rated). */
+static unsigned nextStream(worker_t *w)
+{
+  const worker_stream_t *s;
+  uint64_t due, first = 0;
+  unsigned i, n, rated, unrated;
+
+  rated = unrated = num_streams;
+
+  for (n = 0; n < num_streams; n++)
+  {
+    /* From the stream whose turn it is, so unrated streams alternate. */
+    i = w->turn + n;
+    if (i >= num_streams)
+      i -= num_streams;
+
+    s = &w->streams[i];
+    if (s->done)
+      continue;
+
+    if (!s->pacer.active)
+    {
+      if (unrated == num_streams)
+        unrated = i;
+    }
+    else if ((due = pacerDue(&s->pacer)) < first || rated == num_streams)
+    {
+      rated = i;
+      first = due;
+    }
+  }
+
+  if (unrated != num_streams &&
+      (rated == num_streams || first > pacerClock(&w->streams[rated].pacer)))
+  {
+    w->turn = unrated + 1 < num_streams ? unrated + 1 : 0;
+    return unrated;
+  }
+
+  return rated;
+}
+
+/* Gives worker 'w' its share of every stream, as the command line ones. */
+static int shareStreams(worker_t *w)
+{
+  worker_stream_t *s;
+  threshold_t share, remainder;
+  unsigned i;
+
+  if (posix_memalign((void **)&w->streams, CACHE_LINE_SIZE, num_streams * sizeof(worker_stream_t)))
+  {
+    w->streams = NULL;
+    ERROR("Error allocating workers");
+    return FALSE;
+  }
+
+  for (i = 0; i < num_streams; i++)
+  {
+    s = &w->streams[i];
+    memset(s, 0, sizeof(worker_stream_t));
+
+    s->co = streams[i].co;
+    share = streams[i].co.threshold / num_workers;
+    remainder = streams[i].co.threshold % num_workers;
+    s->co.threshold = share + ((threshold_t)w->id < remainder);
+    s->done = !s->co.flood && s->co.threshold == 0;
+    s->proto = s->co.ip.protocol;
+
+    /* Each worker starts at its own place, so together they follow the mix. */
+    s->mix = mix_length ? (size_t)w->id * mix_length / num_workers : 0;
+
+    initPacer(&s->pacer, &s->co, num_workers);
+  }
+
+  return TRUE;
+}
+
+/* Spreads the workers over the CPUs this process may run on. */
+static void assignCPUs(void)
+{
+  cpu_set_t set;
+  unsigned i;
+  int cpu;
+
+  if (sched_getaffinity(0, sizeof(set), &set) == -1 || CPU_COUNT(&set) < 2)
+    return;
+
+  for (i = 0, cpu = -1; i < num_workers; i++)
+  {
+    /* Next allowed CPU, wrapping around. */
+    do
+      if (++cpu == CPU_SETSIZE)
+        cpu = 0;
+    while (!CPU_ISSET(cpu, &set));
+
+    workers[i].cpu = cpu;
+  }
+}
+
+static void pinWorker(worker_t *w)
+{
+  cpu_set_t set;
+
+  if (w->cpu < 0)
+    return;
+
+  CPU_ZERO(&set);
+  CPU_SET(w->cpu, &set);
+
+  /* NOTE: Not fatal. The worker just runs wherever the scheduler wants. */
+  if ((errno = pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) != 0)
+    perror("Error pinning worker thread");
+}